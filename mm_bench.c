@@ -0,0 +1,806 @@
+/*
+ * mm_bench.c
+ * _______________________________________________________________
+ * Replay allocation traces against mm_malloc/mm_free/mm_realloc and
+ * against the system allocator, and report for each:
+ * 1. Throughput in operations per second.
+ * 2. p50 and p99 latency of one operation.
+ * 3. Peak live bytes (the payloads asked for) against the peak heap
+ *    footprint, and the utilization they give.
+ * 4. Heap extensions (mem_sbrk), mappings and unmappings (mm only) and
+ *    minor page faults.
+ *
+ * Build:  gcc -O2 -DDRIVER -o mm_bench mm_bench.c mm_grade_91.c memlib.c \
+ *                 -lpthread -lm
+ * Usage:  mm_bench [-t threads] [-n ops] [-s seed] [-a mm|libc|both]
+ *                  [-H histogram] [workload ...]
+ *
+ * A workload is an mdriver trace file or one of the generators:
+ *   uniform   random frees and allocations of 1 to 4096 bytes
+ *   powerlaw  the same with sizes drawn from a Pareto distribution
+ *   prodcons  blocks freed in the order they were allocated; with
+ *             threads, one thread of each pair allocates and the other
+ *             frees what it receives
+ *   vector    arrays grown by realloc by half their size, then freed
+ * With no workload all four generators run.
+ *
+ * With -t every thread replays its own copy of the trace at the same
+ * time (prodcons pairs the threads up instead).  Latency is timed on
+ * one operation out of LATENCY_EVERY.
+ *
+ * -H writes the sizes the workloads allocate, "bytes count" per line,
+ * for mm_classgen.
+ *
+ * Trace format (mdriver): four header numbers (suggested heap size,
+ * number of ids, number of operations, weight), then one operation per
+ * line: "a id size", "r id size" or "f id".
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <malloc.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "mm_ext.h"
+#include "memlib.h"
+
+#define MAXTHREADS    64
+#define DEFAULT_OPS   200000
+#define NIDS          1024      /* Live ids of the random generators */
+#define FIFO_DEPTH    256       /* Blocks in flight for prodcons */
+#define RING_SIZE     1024      /* Slots of a prodcons ring, power of 2 */
+#define LATENCY_EVERY 8         /* Time one operation out of this many */
+#define LIVE_EVERY    64        /* Sum live bytes of all threads this often */
+#define FOOT_EVERY    1024      /* Sample the libc footprint this often */
+#define HIST_SUB      16        /* Histogram buckets per power of 2 */
+#define HIST_BUCKETS  (64 * HIST_SUB)
+
+#define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
+
+/* One operation of a trace */
+struct op {
+    char type;                  /* 'a', 'r' or 'f' */
+    int id;
+    size_t size;
+};
+
+struct trace {
+    char name[64];
+    int nids;
+    size_t nops;
+    struct op *ops;
+};
+
+/* The allocator a run is replayed against */
+struct allocator {
+    const char *name;
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void (*reset)(void);
+    size_t (*footprint)(void);  /* Bytes held from the OS right now */
+};
+
+/* Per-thread state, padded so threads never share a line */
+struct worker {
+    pthread_t tid;
+    int index;
+    const struct trace *tr;
+    const struct allocator *al;
+    struct ring *ring;          /* prodcons: the ring of the pair */
+    int role;                   /* prodcons: 0 alone, 1 producer, 2 consumer */
+    size_t live;                /* Payload bytes this thread holds */
+    size_t peak_live;           /* Most live bytes of all threads it saw */
+    size_t peak_foot;           /* Largest footprint it sampled */
+    unsigned long nops;
+    unsigned long nfail;        /* Allocations that returned NULL */
+    unsigned long hist[HIST_BUCKETS];
+} __attribute__((aligned(64)));
+
+/* Single producer, single consumer ring of blocks */
+struct ring {
+    size_t head __attribute__((aligned(64)));   /* Written by the producer */
+    size_t tail __attribute__((aligned(64)));   /* Written by the consumer */
+    void *slot[RING_SIZE];
+    size_t size[RING_SIZE];
+};
+
+static struct worker workers[MAXTHREADS];
+static int nthreads = 1;
+static pthread_barrier_t start_barrier;
+
+/* Private helper functions */
+static struct trace *read_trace(const char *file);
+static struct trace *gen_trace(const char *name, size_t nops,
+                               unsigned seed);
+static void free_trace(struct trace *tr);
+static int write_histogram(const char *file, struct trace **trs, int n);
+static int size_compare(const void *a, const void *b);
+static void run(const struct trace *tr, const struct allocator *al);
+static void *worker_main(void *arg);
+static void replay(struct worker *w);
+static void produce(struct worker *w);
+static void consume(struct worker *w);
+static void account(struct worker *w, long delta);
+static void record(struct worker *w, uint64_t ns);
+static uint64_t percentile(const unsigned long *hist, double q);
+static uint64_t now_ns(void);
+static unsigned rnd(unsigned *state);
+
+/*
+ * The allocators
+ */
+static void mm_reset(void)
+{
+    mem_reset_brk();
+    if (mm_init() < 0)
+    {
+        fprintf(stderr, "mm_init failed\n");
+        exit(1);
+    }
+}
+
+static size_t mm_footprint(void)
+{
+    struct mm_stats st;
+    mm_stats(&st);
+    return st.heap + st.mapped;
+}
+
+/* What libc held after mem_init, memlib's heap included */
+static size_t libc_base;
+
+static void libc_reset(void)
+{
+    malloc_trim(0);
+}
+
+static size_t libc_footprint(void)
+{
+    #if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+    #else
+    struct mallinfo mi = mallinfo();
+    #endif
+    return (size_t)mi.arena + (size_t)mi.hblkhd - libc_base;
+}
+
+static const struct allocator mm_allocator = {
+    "mm", mm_malloc, mm_free, mm_realloc, mm_reset, mm_footprint
+};
+static const struct allocator libc_allocator = {
+    "libc", malloc, free, realloc, libc_reset, libc_footprint
+};
+
+
+int main(int argc, char **argv)
+{
+    static const char *generators[] = {
+        "uniform", "powerlaw", "prodcons", "vector"
+    };
+    const struct allocator *als[2];
+    size_t nops = DEFAULT_OPS;
+    unsigned seed = 1;
+    const char **names = generators;
+    const char *histogram = NULL;
+    struct trace **trs;
+    int nals = 0, nnames = 4, opt, i, j;
+
+    while ((opt = getopt(argc, argv, "t:n:s:a:H:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'n':
+            nops = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'a':
+            nals = 0;
+            if (strcmp(optarg, "mm") == 0 || strcmp(optarg, "both") == 0)
+                als[nals++] = &mm_allocator;
+            if (strcmp(optarg, "libc") == 0 || strcmp(optarg, "both") == 0)
+                als[nals++] = &libc_allocator;
+            if (nals == 0)
+                goto usage;
+            break;
+        case 'H':
+            histogram = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (nthreads < 1 || nthreads > MAXTHREADS || nops == 0)
+        goto usage;
+    if (optind < argc)
+    {
+        names = (const char **)argv + optind;
+        nnames = argc - optind;
+    }
+    if (nals == 0)
+    {
+        als[nals++] = &mm_allocator;
+        als[nals++] = &libc_allocator;
+    }
+
+    mem_init();
+    libc_base = libc_footprint();
+    if (mm_init() < 0)
+    {
+        fprintf(stderr, "mm_init failed\n");
+        return 1;
+    }
+    printf("%-12s %-5s %3s %12s %8s %8s %10s %10s %6s %6s %6s %6s %8s\n",
+           "workload", "alloc", "thr", "ops/s", "p50(ns)", "p99(ns)",
+           "peak-live", "peak-heap", "util%", "sbrk", "mmap", "munmap",
+           "minflt");
+    trs = calloc(nnames, sizeof(struct trace *));
+    for (i = 0; i < nnames; i++)
+    {
+        if ((trs[i] = gen_trace(names[i], nops, seed)) == NULL &&
+            (trs[i] = read_trace(names[i])) == NULL)
+            return 1;
+        for (j = 0; j < nals; j++)
+            run(trs[i], als[j]);
+    }
+    if (histogram != NULL && write_histogram(histogram, trs, nnames) < 0)
+        return 1;
+    for (i = 0; i < nnames; i++)
+        free_trace(trs[i]);
+    free(trs);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-t threads] [-n ops] [-s seed] "
+            "[-a mm|libc|both] [-H histogram] [trace-file|uniform|powerlaw|prodcons|"
+            "vector ...]\n", argv[0]);
+    return 2;
+}
+
+/*
+ * run - replay tr with nthreads threads against al and print one line
+ */
+static void run(const struct trace *tr, const struct allocator *al)
+{
+    static struct ring rings[MAXTHREADS / 2];
+    static unsigned long hist[HIST_BUCKETS];
+    struct mm_stats before, after;
+    struct rusage ru0, ru1;
+    size_t peak_live = 0, peak_foot = 0;
+    unsigned long nops = 0, nfail = 0;
+    int prodcons = strcmp(tr->name, "prodcons") == 0 && nthreads > 1;
+    uint64_t t0, t1;
+    double secs;
+    int i, k;
+
+    al->reset();
+    memset(hist, 0, sizeof(hist));
+    memset(rings, 0, sizeof(rings));
+    for (i = 0; i < nthreads; i++)
+    {
+        struct worker *w = &workers[i];
+        memset(w, 0, sizeof(*w));
+        w->index = i;
+        w->tr = tr;
+        w->al = al;
+        if (prodcons && (i ^ 1) < nthreads)
+        {
+            w->ring = &rings[i / 2];
+            w->role = 1 + (i & 1);
+        }
+    }
+    pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+    mm_stats(&before);
+
+    for (i = 0; i < nthreads; i++)
+        if (pthread_create(&workers[i].tid, NULL, worker_main,
+                           &workers[i]) != 0)
+        {
+            fprintf(stderr, "pthread_create failed\n");
+            exit(1);
+        }
+    getrusage(RUSAGE_SELF, &ru0);
+    pthread_barrier_wait(&start_barrier);
+    t0 = now_ns();
+    for (i = 0; i < nthreads; i++)
+        pthread_join(workers[i].tid, NULL);
+    t1 = now_ns();
+    getrusage(RUSAGE_SELF, &ru1);
+    pthread_barrier_destroy(&start_barrier);
+
+    mm_stats(&after);
+    for (i = 0; i < nthreads; i++)
+    {
+        struct worker *w = &workers[i];
+        nops += w->nops;
+        nfail += w->nfail;
+        peak_live = MAX(peak_live, w->peak_live);
+        peak_foot = MAX(peak_foot, w->peak_foot);
+        for (k = 0; k < HIST_BUCKETS; k++)
+            hist[k] += w->hist[k];
+    }
+    /* The mm break never goes down, so it is the peak of the heap */
+    if (al == &mm_allocator)
+        peak_foot = MAX(peak_foot, after.heap +
+                        (after.mapped_peak > before.mapped_peak ?
+                         after.mapped_peak : 0));
+    secs = (t1 - t0) / 1e9;
+
+    printf("%-12.12s %-5s %3d %12.0f %8lu %8lu %10zu %10zu %6.1f ",
+           tr->name, al->name, nthreads, nops / secs,
+           (unsigned long)percentile(hist, 0.50),
+           (unsigned long)percentile(hist, 0.99), peak_live, peak_foot,
+           peak_foot ? 100.0 * peak_live / peak_foot : 0.0);
+    if (al == &mm_allocator)
+        printf("%6lu %6lu %6lu ", after.nextend - before.nextend,
+               after.nmmap - before.nmmap, after.nmunmap - before.nmunmap);
+    else
+        printf("%6s %6s %6s ", "-", "-", "-");
+    printf("%8ld", ru1.ru_minflt - ru0.ru_minflt);
+    if (nfail)
+        printf("  (%lu failed)", nfail);
+    printf("\n");
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    pthread_barrier_wait(&start_barrier);
+    if (w->role == 1)
+        produce(w);
+    else if (w->role == 2)
+        consume(w);
+    else
+        replay(w);
+    return NULL;
+}
+
+/*
+ * replay - run the whole trace, then free what it left allocated
+ */
+static void replay(struct worker *w)
+{
+    const struct trace *tr = w->tr;
+    const struct allocator *al = w->al;
+    void **ptr = calloc(tr->nids, sizeof(void *));
+    size_t *size = calloc(tr->nids, sizeof(size_t));
+    size_t i;
+    int id;
+
+    if (ptr == NULL || size == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < tr->nops; i++)
+    {
+        const struct op *op = &tr->ops[i];
+        int timed = (i % LATENCY_EVERY) == 0;
+        uint64_t t = timed ? now_ns() : 0;
+        void *p;
+
+        id = op->id;
+        switch (op->type)
+        {
+        case 'a':
+            p = al->malloc(op->size);
+            break;
+        case 'r':
+            p = al->realloc(ptr[id], op->size);
+            break;
+        default:
+            al->free(ptr[id]);
+            p = NULL;
+            break;
+        }
+        if (timed)
+            record(w, now_ns() - t);
+        w->nops++;
+
+        if (op->type == 'f')
+        {
+            account(w, -(long)size[id]);
+            ptr[id] = NULL;
+            size[id] = 0;
+        }
+        else if (p == NULL && op->size != 0)
+            w->nfail++;
+        else
+        {
+            /* Touch both ends, as a program filling the block would */
+            if (op->size != 0)
+            {
+                ((char *)p)[0] = (char)id;
+                ((char *)p)[op->size - 1] = (char)id;
+            }
+            account(w, (long)op->size - (long)size[id]);
+            ptr[id] = p;
+            size[id] = op->size;
+        }
+    }
+    for (id = 0; id < tr->nids; id++)
+        if (ptr[id] != NULL)
+        {
+            al->free(ptr[id]);
+            account(w, -(long)size[id]);
+        }
+    free(ptr);
+    free(size);
+}
+
+/*
+ * produce - allocate the blocks of the trace and hand them to the
+ *           consumer of the pair
+ */
+static void produce(struct worker *w)
+{
+    struct ring *ring = w->ring;
+    const struct allocator *al = w->al;
+    size_t head = 0, i;
+
+    for (i = 0; i < w->tr->nops; i++)
+    {
+        const struct op *op = &w->tr->ops[i];
+        int timed;
+        uint64_t t;
+        void *p;
+
+        if (op->type != 'a')
+            continue;
+        timed = (w->nops % LATENCY_EVERY) == 0;
+        t = timed ? now_ns() : 0;
+        p = al->malloc(op->size);
+        if (timed)
+            record(w, now_ns() - t);
+        w->nops++;
+        if (p == NULL)
+        {
+            w->nfail++;
+            continue;
+        }
+        memset(p, 0, MIN(op->size, 64));
+        account(w, (long)op->size);
+        while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)
+               == RING_SIZE)
+            sched_yield();
+        ring->slot[head % RING_SIZE] = p;
+        ring->size[head % RING_SIZE] = op->size;
+        __atomic_store_n(&ring->head, ++head, __ATOMIC_RELEASE);
+    }
+    /* A NULL block ends the stream */
+    while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)
+           == RING_SIZE)
+        sched_yield();
+    ring->slot[head % RING_SIZE] = NULL;
+    __atomic_store_n(&ring->head, ++head, __ATOMIC_RELEASE);
+}
+
+/*
+ * consume - free the blocks of the pair's producer as they arrive
+ */
+static void consume(struct worker *w)
+{
+    struct ring *ring = w->ring;
+    const struct allocator *al = w->al;
+    size_t tail = 0;
+
+    for (;;)
+    {
+        int timed;
+        uint64_t t;
+        size_t size;
+        void *p;
+
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+            sched_yield();
+        p = ring->slot[tail % RING_SIZE];
+        size = ring->size[tail % RING_SIZE];
+        __atomic_store_n(&ring->tail, ++tail, __ATOMIC_RELEASE);
+        if (p == NULL)
+            break;
+        timed = (w->nops % LATENCY_EVERY) == 0;
+        t = timed ? now_ns() : 0;
+        al->free(p);
+        if (timed)
+            record(w, now_ns() - t);
+        w->nops++;
+        account(w, -(long)size);
+    }
+}
+
+/*
+ * account - add delta to the live bytes of w, then every LIVE_EVERY
+ *           operations (every one when alone) update the peaks
+ */
+static void account(struct worker *w, long delta)
+{
+    size_t live = 0;
+    int i;
+
+    __atomic_store_n(&w->live, w->live + delta, __ATOMIC_RELAXED);
+    if (nthreads > 1 && w->nops % LIVE_EVERY != 0)
+        return;
+    /* A consumer's live bytes go negative; the sum is still right */
+    for (i = 0; i < nthreads; i++)
+        live += __atomic_load_n(&workers[i].live, __ATOMIC_RELAXED);
+    w->peak_live = MAX(w->peak_live, live);
+    if (w->index == 0 && w->nops % FOOT_EVERY == 0)
+        w->peak_foot = MAX(w->peak_foot, w->al->footprint());
+}
+
+/*
+ * record - count one latency in a log-linear histogram: HIST_SUB
+ *          buckets for every power of 2
+ */
+static void record(struct worker *w, uint64_t ns)
+{
+    int b;
+    if (ns < HIST_SUB)
+        b = (int)ns;
+    else
+    {
+        int msb = 63 - __builtin_clzll(ns);
+        b = (msb - 3) * HIST_SUB + (int)((ns >> (msb - 4)) & (HIST_SUB - 1));
+    }
+    w->hist[MIN(b, HIST_BUCKETS - 1)]++;
+}
+
+/*
+ * percentile - the lower bound of the bucket holding the q quantile
+ */
+static uint64_t percentile(const unsigned long *hist, double q)
+{
+    unsigned long total = 0, seen = 0;
+    int b;
+    for (b = 0; b < HIST_BUCKETS; b++)
+        total += hist[b];
+    for (b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += hist[b];
+        if (seen > 0 && seen >= q * total)
+            break;
+    }
+    if (b < HIST_SUB)
+        return b;
+    if (b == HIST_BUCKETS)
+        return 0;
+    return (uint64_t)(HIST_SUB + b % HIST_SUB) << (b / HIST_SUB - 1);
+}
+
+/*
+ * read_trace - load an mdriver trace, NULL on error
+ */
+static struct trace *read_trace(const char *file)
+{
+    struct trace *tr;
+    FILE *fp = fopen(file, "r");
+    int heap, nids, nops, weight;
+    const char *base = strrchr(file, '/');
+    char type[2];
+    size_t i;
+
+    if (fp == NULL)
+    {
+        perror(file);
+        return NULL;
+    }
+    if (fscanf(fp, "%d %d %d %d", &heap, &nids, &nops, &weight) != 4 ||
+        nids <= 0 || nops < 0)
+    {
+        fprintf(stderr, "%s: bad trace header\n", file);
+        fclose(fp);
+        return NULL;
+    }
+    tr = calloc(1, sizeof(*tr));
+    tr->ops = calloc(nops ? nops : 1, sizeof(struct op));
+    snprintf(tr->name, sizeof(tr->name), "%s", base ? base + 1 : file);
+    tr->nids = nids;
+    for (i = 0; i < (size_t)nops && fscanf(fp, "%1s", type) == 1; i++)
+    {
+        struct op *op = &tr->ops[i];
+        unsigned long size = 0;
+        int ok;
+        op->type = type[0];
+        if (op->type == 'f')
+            ok = fscanf(fp, "%d", &op->id) == 1;
+        else
+            ok = (op->type == 'a' || op->type == 'r') &&
+                 fscanf(fp, "%d %lu", &op->id, &size) == 2;
+        if (!ok || op->id < 0 || op->id >= nids)
+        {
+            fprintf(stderr, "%s: bad operation %zu\n", file, i);
+            fclose(fp);
+            free_trace(tr);
+            return NULL;
+        }
+        op->size = size;
+    }
+    tr->nops = i;
+    fclose(fp);
+    return tr;
+}
+
+/*
+ * gen_trace - build nops operations of the named generator, NULL if
+ *             there is no such generator
+ */
+static struct trace *gen_trace(const char *name, size_t nops, unsigned seed)
+{
+    struct trace *tr;
+    size_t *size;
+    char *live;
+    size_t i = 0;
+    int id;
+
+    if (strcmp(name, "uniform") && strcmp(name, "powerlaw") &&
+        strcmp(name, "prodcons") && strcmp(name, "vector"))
+        return NULL;
+    tr = calloc(1, sizeof(*tr));
+    snprintf(tr->name, sizeof(tr->name), "%s", name);
+    tr->nids = NIDS;
+    tr->nops = nops;
+    tr->ops = calloc(nops, sizeof(struct op));
+    size = calloc(NIDS, sizeof(size_t));
+    live = calloc(NIDS, 1);
+
+    if (strcmp(name, "prodcons") == 0)
+    {
+        /* Allocate one, free the one allocated FIFO_DEPTH before */
+        size_t n;
+        tr->nids = FIFO_DEPTH;
+        for (n = 0; i < nops; n++)
+        {
+            id = (int)(n % FIFO_DEPTH);
+            if (live[id])
+                tr->ops[i++] = (struct op){'f', id, 0};
+            if (i < nops)
+                tr->ops[i++] = (struct op){'a', id, 16 + rnd(&seed) % 497};
+            live[id] = 1;
+        }
+        tr->nops = i;
+    }
+    else if (strcmp(name, "vector") == 0)
+    {
+        /* Grow random arrays to a random final size, then drop them */
+        size_t *final = calloc(NIDS, sizeof(size_t));
+        tr->nids = 64;
+        while (i < nops)
+        {
+            id = rnd(&seed) % tr->nids;
+            if (!live[id])
+            {
+                size[id] = 16;
+                final[id] = (size_t)64 << (rnd(&seed) % 13);
+                tr->ops[i++] = (struct op){'a', id, size[id]};
+                live[id] = 1;
+            }
+            else if (size[id] >= final[id])
+            {
+                tr->ops[i++] = (struct op){'f', id, 0};
+                live[id] = 0;
+            }
+            else
+            {
+                size[id] += size[id] / 2;
+                tr->ops[i++] = (struct op){'r', id, size[id]};
+            }
+        }
+        free(final);
+    }
+    else
+    {
+        /* Flip a random id: allocate it if free, else free or resize it */
+        int pareto = strcmp(name, "powerlaw") == 0;
+        while (i < nops)
+        {
+            size_t sz;
+            id = rnd(&seed) % NIDS;
+            if (pareto)
+            {
+                /* P(size > x) = (16 / x)^1.2, at most 1 MB */
+                double u = (rnd(&seed) + 1.0) / 4294967296.0;
+                double x = 16.0 * pow(u, -1 / 1.2);
+                sz = x < (1 << 20) ? (size_t)x : (1 << 20);
+            }
+            else
+                sz = 1 + rnd(&seed) % 4096;
+            if (!live[id])
+            {
+                tr->ops[i++] = (struct op){'a', id, sz};
+                live[id] = 1;
+            }
+            else if (rnd(&seed) % 8 == 0)
+                tr->ops[i++] = (struct op){'r', id, sz};
+            else
+            {
+                tr->ops[i++] = (struct op){'f', id, 0};
+                live[id] = 0;
+            }
+        }
+    }
+    free(size);
+    free(live);
+    return tr;
+}
+
+static void free_trace(struct trace *tr)
+{
+    free(tr->ops);
+    free(tr);
+}
+
+/*
+ * write_histogram - write how often the n traces allocate each size,
+ *                   -1 on error
+ */
+static int write_histogram(const char *file, struct trace **trs, int n)
+{
+    size_t nsizes = 0, i, j;
+    size_t *sizes;
+    FILE *fp;
+    int k;
+
+    for (k = 0; k < n; k++)
+        nsizes += trs[k]->nops;
+    sizes = malloc((nsizes + 1) * sizeof(size_t));
+    for (k = 0, nsizes = 0; k < n; k++)
+        for (i = 0; i < trs[k]->nops; i++)
+            if (trs[k]->ops[i].type != 'f' && trs[k]->ops[i].size != 0)
+                sizes[nsizes++] = trs[k]->ops[i].size;
+    qsort(sizes, nsizes, sizeof(size_t), size_compare);
+    if ((fp = fopen(file, "w")) == NULL)
+    {
+        perror(file);
+        free(sizes);
+        return -1;
+    }
+    fprintf(fp, "# bytes count\n");
+    for (i = 0; i < nsizes; i = j)
+    {
+        for (j = i; j < nsizes && sizes[j] == sizes[i]; j++)
+            ;
+        fprintf(fp, "%zu %zu\n", sizes[i], j - i);
+    }
+    fclose(fp);
+    free(sizes);
+    return 0;
+}
+
+static int size_compare(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* xorshift32 */
+static unsigned rnd(unsigned *state)
+{
+    unsigned x = *state ? *state : 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
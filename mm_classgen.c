@@ -0,0 +1,280 @@
+/*
+ * mm_classgen.c
+ * _______________________________________________________________
+ * Generate the free list size classes of mm_grade_91.c (LIST1..LIST17
+ * and the lookup table of choosefreetable_bysize) for a histogram of
+ * allocation sizes, such as mm_bench -H writes.
+ *
+ * Build:  gcc -O2 -o mm_classgen mm_classgen.c
+ * Usage:  mm_classgen [-w overhead] [-b minblock] [-s slabmax] [-o file.h]
+ *                    histogram
+ *         gcc ... -DSIZECLASS_FILE='"file.h"' mm_grade_91.c ...
+ *
+ * The histogram has one "bytes count" pair per line; lines starting with
+ * '#' are skipped.  -w and -b give OVERHEAD and MINBLOCK of the build
+ * (4 and 16 by default, as with ELIDE_FOOTERS and COMPACT_LINKS), -s
+ * SLAB_MAXSIZE (128, 0 without SLAB): slabs keep one class per block
+ * size already, so the lists never see those sizes.
+ *
+ * A block of u DSIZE units goes to the first list whose bound is >= u.
+ * First fit in a list hands out a block of up to the bound, so the
+ * tables are chosen to minimize the expected slack
+ *     sum over u of weight(u) * (bound of u - u)
+ * over blocks up to LIST17; larger blocks go to the last list, which is
+ * searched for the best fit.  Only block sizes the lists serve are bounds:
+ * multiples of ALIGNMENT, from the first above the slabs and MINBLOCK.
+ * The weight of a size is its count plus a share of PRIOR of all
+ * allocations spread in proportion to 1/u over those sizes, so lists the
+ * histogram leaves no use for still split the sizes it never saw
+ * geometrically rather than sit empty.  The slack reported is that of
+ * the counts alone.  The allocator needs the bounds to rise, to
+ * double above SMALLCLASS_MAX = 2^t, and LIST10 to hold a skip list node
+ * (10 units); LIST17 is kept between 2048 units and MMAP_THRESHOLD.
+ * For each t the bounds up to 2^t are placed by dynamic programming.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NLISTS      17          /* LIST1..LIST17 */
+#define DSIZE       8
+#define ALIGNMENT   16          /* Block sizes are multiples of it */
+#define MAXUNITS    2048        /* Largest SMALLCLASS_MAX */
+#define MINLIST17   2048        /* Smallest LIST17 */
+#define MINLIST10   10          /* Units of a skip list node */
+#define MAXLIST17   16384       /* Largest LIST17, MMAP_THRESHOLD */
+#define STEP        (ALIGNMENT / DSIZE) /* Units between two block sizes */
+#define PRIOR       0.01        /* Share of the weight spread over sizes */
+#define MAX(x, y)   ((x) > (y) ? (x) : (y))
+
+/* The default bounds of mm_grade_91.c, for comparison */
+static const long default_bounds[NLISTS] = {
+    2, 4, 6, 8, 10, 12, 14, 16, 24, 32, 64, 128, 256, 512, 1024, 2048, 4096
+};
+
+/* Allocations of each block size, those above MAXLIST17 counted last */
+static double count[MAXLIST17 + 2];
+static double weight[MAXLIST17 + 2];    /* count with the prior added */
+static double total;                    /* All allocations of the lists */
+static double slabbed;                  /* Allocations left to slabs */
+static double C[MAXUNITS + 1];          /* Prefix sums of weight */
+static double S[MAXUNITS + 1];          /* Prefix sums of weight * u */
+
+/* Private helper functions */
+static double slack(const double *w, const long *bound);
+static double cost(long i, long j);
+static void write_header(FILE *fp, const char *from, const long *bound,
+                         int t, double best, double before);
+
+int main(int argc, char **argv)
+{
+    static double dp[NLISTS + 1][MAXUNITS + 1];
+    static long from[NLISTS + 1][MAXUNITS + 1];
+    long overhead = 4, minblock = 16, slabmax = 128, bytes, u, i, j, first;
+    long bound[NLISTS], best_bound[NLISTS];
+    double n, best = -1, before, harmonic = 0;
+    const char *out = NULL;
+    char line[256];
+    int opt, m, k, t, best_t = 0;
+    FILE *fp;
+
+    while ((opt = getopt(argc, argv, "w:b:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w':
+            overhead = atol(optarg);
+            break;
+        case 'b':
+            minblock = atol(optarg);
+            break;
+        case 's':
+            slabmax = atol(optarg);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind != argc - 1)
+        goto usage;
+    if ((fp = fopen(argv[optind], "r")) == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        if (line[0] == '#' || sscanf(line, "%ld %lf", &bytes, &n) != 2 ||
+            bytes <= 0 || n <= 0)
+            continue;
+        /* adjust_size, in DSIZE units */
+        u = (bytes + overhead + ALIGNMENT - 1) / ALIGNMENT * STEP;
+        if (u < minblock / DSIZE)
+            u = minblock / DSIZE;
+        if (u * DSIZE <= slabmax)
+        {
+            slabbed += n;
+            continue;
+        }
+        if (u > MAXLIST17)
+            u = MAXLIST17 + 1;
+        count[u] += n;
+        total += n;
+    }
+    fclose(fp);
+    if (total == 0)
+    {
+        fprintf(stderr, "%s: no allocations above the slabs\n", argv[optind]);
+        return 1;
+    }
+    /* The smallest block size the lists serve, in units */
+    first = MAX((slabmax / ALIGNMENT + 1) * STEP,
+                (minblock + ALIGNMENT - 1) / ALIGNMENT * STEP);
+    for (u = first; u <= MAXLIST17; u += STEP)
+        harmonic += 1.0 / u;
+    memcpy(weight, count, sizeof(count));
+    for (u = first; u <= MAXLIST17; u += STEP)
+        weight[u] += PRIOR * total / (u * harmonic);
+    for (u = 1; u <= MAXUNITS; u++)
+    {
+        C[u] = C[u-1] + weight[u];
+        S[u] = S[u-1] + weight[u] * u;
+    }
+
+    /*
+     * dp[k][j]: least slack of k lists with bounds up to j, the last j.
+     * Bounds are block sizes from first on; 0 stands for no list yet.
+     */
+    for (k = 0; k <= NLISTS; k++)
+        for (j = 0; j <= MAXUNITS; j++)
+            dp[k][j] = -1;
+    dp[0][0] = 0;
+    for (k = 1; k <= NLISTS; k++)
+    {
+        for (j = first; j <= MAXUNITS; j += STEP)
+        {
+            for (i = 0; i < j; i = i ? i + STEP : first)
+            {
+                double c;
+                if (dp[k-1][i] < 0)
+                    continue;
+                c = dp[k-1][i] + cost(i, j);
+                if (dp[k][j] < 0 || c < dp[k][j])
+                {
+                    dp[k][j] = c;
+                    from[k][j] = i;
+                }
+            }
+        }
+    }
+
+    /* SMALLCLASS_MAX = 2^t is bound m, and the bounds double after it */
+    for (t = 4; (1L << t) <= MAXUNITS; t++)
+    {
+        for (m = 1; m <= NLISTS && m <= (1L << t); m++)
+        {
+            if ((1L << t) << (NLISTS - m) < MINLIST17 ||
+                (1L << t) << (NLISTS - m) > MAXLIST17 ||
+                (1L << t) % STEP != 0 || dp[m][1L << t] < 0)
+                continue;
+            for (k = m, j = 1L << t; k > 0; j = from[k--][j])
+                bound[k-1] = j;
+            for (k = m; k < NLISTS; k++)
+                bound[k] = 2 * bound[k-1];
+            if (bound[9] < MINLIST10)
+                continue;
+            if (best < 0 || slack(weight, bound) < best)
+            {
+                best = slack(weight, bound);
+                best_t = t;
+                memcpy(best_bound, bound, sizeof(bound));
+            }
+        }
+    }
+
+    if (best < 0)
+    {
+        fprintf(stderr, "%s: no tables fit the allocator\n", argv[0]);
+        return 1;
+    }
+    best = slack(count, best_bound);
+    before = slack(count, default_bounds);
+    fprintf(stderr, "slack per allocation: %.1f bytes, %.1f by default "
+            "(%.0f allocations left to slabs)\n", best / total,
+            before / total, slabbed);
+    if (out != NULL && (fp = fopen(out, "w")) == NULL)
+    {
+        perror(out);
+        return 1;
+    }
+    write_header(out ? fp : stdout, argv[optind], best_bound, best_t,
+                 best, before);
+    if (out != NULL)
+        fclose(fp);
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-w overhead] [-b minblock] [-s slabmax] "
+            "[-o file.h] histogram\n", argv[0]);
+    return 2;
+}
+
+/*
+ * cost - slack bytes of one list holding the units i+1 to j
+ */
+static double cost(long i, long j)
+{
+    return ((C[j] - C[i]) * j - (S[j] - S[i])) * DSIZE;
+}
+
+/*
+ * slack - slack bytes of the whole histogram w with the given bounds
+ */
+static double slack(const double *w, const long *bound)
+{
+    double sum = 0;
+    long u;
+    int k = 0;
+
+    for (u = 1; u <= bound[NLISTS-1]; u++)
+    {
+        while (bound[k] < u)
+            k++;
+        sum += w[u] * (bound[k] - u) * DSIZE;
+    }
+    return sum;
+}
+
+/*
+ * write_header - write the bounds and lookup table for SIZECLASS_FILE
+ */
+static void write_header(FILE *fp, const char *from, const long *bound,
+                         int t, double best, double before)
+{
+    long u;
+    int k = 0;
+
+    fprintf(fp, "/*\n"
+            " * Size classes generated by mm_classgen from %s:\n"
+            " * %.0f allocations, %.1f bytes of slack each (%.1f with the\n"
+            " * default classes), %.0f more left to slabs\n"
+            " */\n", from, total, best / total, before / total, slabbed);
+    for (k = 0; k < NLISTS; k++)
+        fprintf(fp, "#define LIST%-2d   %ld\n", k + 1, bound[k]);
+    fprintf(fp, "#define SMALLCLASS_MAX   %ld\n", 1L << t);
+    fprintf(fp, "#define SMALLCLASS_LOG2  %d\n", t);
+    fprintf(fp, "#define SIZECLASS_TABLE { \\\n   ");
+    for (u = 0, k = 0; u <= (1L << t); u++)
+    {
+        while (bound[k] < u)
+            k++;
+        fprintf(fp, " %d%s", k + 1, u < (1L << t) ? "," : "");
+        if (u % 16 == 15 && u < (1L << t))
+            fprintf(fp, " \\\n   ");
+    }
+    fprintf(fp, " \\\n}\n");
+}
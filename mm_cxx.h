@@ -0,0 +1,144 @@
+/*
+ * mm_cxx.h
+ * _______________________________________________________________
+ * C++17 adapters of the allocator of mm_grade_91.c:
+ * 1. mm::heap_resource, a std::pmr::memory_resource on the heap whose
+ *    deallocations are sized (mm_free_sized).
+ * 2. mm::region, owning a region of mm_region_create, and
+ *    mm::region_allocator, an allocator for standard containers that
+ *    takes their memory from a region.  Deallocation does nothing; the
+ *    memory goes when the region is reset or destroyed.
+ * The global operator new and delete are replaced by mm_new.cc.
+ */
+#ifndef MM_CXX_H
+#define MM_CXX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+#include "mm_ext.h"
+
+namespace mm {
+
+/*
+ * heap_resource - memory resource of the heap.  Every instance hands out
+ *                 the same heap, so all of them compare equal.
+ */
+class heap_resource : public std::pmr::memory_resource {
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        void *p = mm_memalign(alignment, bytes ? bytes : 1);
+
+        if (p == nullptr)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void do_deallocate(void *p, std::size_t bytes,
+                       std::size_t alignment) override
+    {
+        (void)alignment;
+        mm_free_sized(p, bytes ? bytes : 1);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const
+        noexcept override
+    {
+        return dynamic_cast<const heap_resource *>(&other) != nullptr;
+    }
+};
+
+/*
+ * get_heap_resource - the heap_resource of the program, for
+ *                     std::pmr::set_default_resource and the like
+ */
+inline heap_resource *get_heap_resource() noexcept
+{
+    static heap_resource resource;
+    return &resource;
+}
+
+/*
+ * region - owner of a region, destroyed with it.  Like the region, it is
+ *          used by one thread at a time.
+ */
+class region {
+public:
+    explicit region(std::size_t chunk = 0) : rg(mm_region_create(chunk))
+    {
+        if (rg == nullptr)
+            throw std::bad_alloc();
+    }
+    ~region() { mm_region_destroy(rg); }
+    region(const region &) = delete;
+    region &operator=(const region &) = delete;
+
+    void *allocate(std::size_t bytes,
+                   std::size_t alignment = MM_ALIGNMENT)
+    {
+        void *p = mm_region_memalign(rg, alignment, bytes ? bytes : 1);
+
+        if (p == nullptr)
+            throw std::bad_alloc();
+        return p;
+    }
+    /* Free everything allocated from the region at once */
+    void reset() noexcept { mm_region_reset(rg); }
+    mm_region *get() const noexcept { return rg; }
+
+private:
+    mm_region *rg;
+};
+
+/*
+ * region_allocator - allocator of T from a region.  Copies, rebound or
+ *                    not, share the region and compare equal.
+ */
+template <class T>
+class region_allocator {
+public:
+    using value_type = T;
+
+    region_allocator(region &r) noexcept : rg(r.get()) {}
+    explicit region_allocator(mm_region *r) noexcept : rg(r) {}
+    template <class U>
+    region_allocator(const region_allocator<U> &other) noexcept
+        : rg(other.rg) {}
+
+    T *allocate(std::size_t n)
+    {
+        std::size_t alignment =
+            alignof(T) > MM_ALIGNMENT ? alignof(T) : MM_ALIGNMENT;
+        void *p;
+
+        if (n > SIZE_MAX / sizeof(T))
+            throw std::bad_array_new_length();
+        p = mm_region_memalign(rg, alignment, n ? n * sizeof(T) : 1);
+        if (p == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+    void deallocate(T *, std::size_t) noexcept {}
+
+    template <class U>
+    bool operator==(const region_allocator<U> &other) const noexcept
+    {
+        return rg == other.rg;
+    }
+    template <class U>
+    bool operator!=(const region_allocator<U> &other) const noexcept
+    {
+        return rg != other.rg;
+    }
+
+private:
+    template <class U> friend class region_allocator;
+    mm_region *rg;
+};
+
+} /* namespace mm */
+
+#endif /* MM_CXX_H */
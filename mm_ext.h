@@ -0,0 +1,87 @@
+/*
+ * mm_ext.h
+ * _______________________________________________________________
+ * Extensions to the interface of mm.h, implemented by mm_grade_91.c.
+ */
+#ifndef MM_EXT_H
+#define MM_EXT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of free lists, MAXFREESIZE of the allocator */
+#define MM_STATS_LISTS 18
+
+/* Alignment of every block, ALIGNMENT of the allocator */
+#define MM_ALIGNMENT 16
+
+/*
+ * Statistics of mm_stats: the counters of one arena, or of the whole
+ * heap in a snapshot.  Byte counts are block sizes, headers included,
+ * and a list is the free list a block size belongs to.
+ */
+struct mm_stats {
+    size_t heap;                   /* Bytes obtained with mem_sbrk */
+    size_t released;               /* Bytes of free pages given back */
+    size_t live;                   /* Bytes of allocated heap blocks */
+    size_t peak;                   /* Most live bytes at once */
+    size_t mapped;                 /* Bytes of mapped blocks */
+    size_t mapped_peak;            /* Most bytes mapped at once */
+    unsigned long nmalloc[MM_STATS_LISTS]; /* Blocks handed out, per list */
+    unsigned long nfree[MM_STATS_LISTS];   /* Blocks freed, per list */
+    unsigned long nmmap;           /* Blocks mapped */
+    unsigned long nmunmap;         /* Blocks unmapped */
+    unsigned long nsearch;         /* find_fit searches */
+    unsigned long nprobe;          /* Free blocks they looked at */
+    unsigned long nsplit;          /* Free blocks split by place */
+    unsigned long ncoalesce[4];    /* Frees by coalesce case 1 to 4 */
+    unsigned long nextend;         /* Heap extensions */
+    size_t extended;               /* Bytes they added */
+    unsigned long tcache_hits;     /* Mallocs served by the thread cache */
+    unsigned long tcache_puts;     /* Frees kept by the thread cache */
+    unsigned long nlocal;          /* Mallocs of an arena on the NUMA */
+                                   /* node of the caller (NUMA) */
+    unsigned long nremote;         /* Mallocs of an arena on another, or */
+                                   /* no, node (NUMA) */
+};
+
+/* A block of mm_malloc_sized_result and its usable size */
+struct mm_sized_result {
+    void *ptr;
+    size_t size;
+};
+
+/* A region of objects freed together, created by mm_region_create */
+struct mm_region;
+
+int mm_trim(size_t pad);
+int mm_fit_policy(int policy, int probes);
+void mm_consolidate(void);
+void *mm_memalign(size_t alignment, size_t size);
+void *mm_aligned_alloc(size_t alignment, size_t size);
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+size_t mm_malloc_batch(size_t size, void **ptrs, size_t n);
+void mm_free_batch(void **ptrs, size_t n);
+void mm_free_sized(void *ptr, size_t size);
+size_t mm_usable_size(void *ptr);
+struct mm_sized_result mm_malloc_sized_result(size_t size);
+int mm_stats(struct mm_stats *st);
+void mm_stats_print(FILE *fp);
+int mm_profile(size_t rate);
+int mm_profile_dump(FILE *fp);
+struct mm_region *mm_region_create(size_t chunk);
+void *mm_region_alloc(struct mm_region *rg, size_t size);
+void *mm_region_memalign(struct mm_region *rg, size_t alignment,
+                         size_t size);
+void mm_region_reset(struct mm_region *rg);
+void mm_region_destroy(struct mm_region *rg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MM_EXT_H */
@@ -3,23 +3,82 @@
  * _______________________________________________________________
  * Dynamically allocate Memory with approaches:
  * 1. Segregated Free list.
- * 2. FILO inserting method.
- * 3. First-fit searching method.
+ * 2. FILO inserting method, or lists ordered by address or size
+ *    (INSERT_POLICY), kept in skip lists for the doubling lists.
+ *    The last list is ordered by size and indexed by a red-black tree
+ *    (LARGE_TREE).
+ * 3. First-fit searching method, or bounded best fit or exact class first
+ *    (FIT_POLICY, mm_fit_policy).
+ * 4. Per-thread caches (TCACHE) of small blocks in front of the lists.
+ * 5. NARENAS independent arenas, each with its own lists and lock.
+ * 6. Slabs (SLAB) of header-less objects for the smallest block sizes.
+ * 7. Blocks of MMAP_THRESHOLD bytes and up mapped on their own (MMAP_LARGE).
+ * 8. Pages of free blocks handed back to the OS (HEAP_TRIM, mm_trim).
+ * 9. Fast bins (FASTBINS) of freed blocks whose coalescing is deferred
+ *    (mm_consolidate).
+ * 10. A heap profile (PROFILE) of sampled allocations and their stacks
+ *    (mm_profile, mm_profile_dump).
+ * 11. Arenas grown in transparent huge pages (HUGEPAGES) and bound to the
+ *    NUMA node of their threads (NUMA).
+ * 12. Regions (mm_region_create) of objects bump-allocated from chunks
+ *    and freed all at once.
  *
  * Heap structure:
  * ----------------------------------------------------------------
- * |   <1>   |<2>|<3>|                  <4>                   |<5>|
+ * |   <1>   |<0>|<2>|<3>|                <4>                 |<5>|
  * ----------------------------------------------------------------
- *               ^
- *               | <-heap_listp always points to here
+ *           ^       ^
+ *           |       | <-prologue of the segment
+ *           | <-segment start (lastseg of its arena for the newest one)
  *
- * Zone <1>: maintains an area that stores addresses of free list headers
- *           including necessary paddings.
+ * Zone <1>: maintains an area that stores the arenas (each with the
+ *           addresses of its free list headers), including necessary
+ *           paddings.
+ * Zone <0>: Segment link - length: WSIZE, heap offset of the previous
+ *           segment of the same arena (0 for the first one)
  * Zone <2>: Prologue header - length: WSIZE
  * Zone <3>: Prologue footer - length: WSIZE
  * Zone <4>: Blocks (including necessary paddings)
  * Zone <5>: Epilogue header - length: WSIZE
  *
+ * Zones <0> to <5> form one segment.  An arena grows its newest segment
+ * in place while that segment ends the heap, and starts a new segment
+ * once another arena has taken the end.  With NARENAS > 1 segments start
+ * on a page boundary and a page map records the arena owning each page.
+ * The page map is one byte per page of MAXHEAP, mapped once and left for
+ * the OS to fill in as the heap grows.
+ *
+ * A slab is the page-aligned payload of one allocated block, cut into
+ * objects of a single block size up to SLAB_MAXSIZE.  Its page is flagged
+ * in the page map, so free() tells slab objects from blocks by address.
+ * An arena keeps up to SLAB_CACHE emptied slabs, still flagged, for its
+ * next new slabs, so slab churn does not cut a page-aligned block out of
+ * the lists and coalesce it back every time.
+ *
+ * A mapped block lives outside the heap in a mapping of its own:
+ * padding, then a word holding the bytes of the mapping before the
+ * payload (MMAP_OVERHEAD, or up to a page for mm_memalign), the header,
+ * tagged MMAPPED, and the aligned payload.  The header holds the bytes
+ * of the mapping from the payload on, a multiple of DSIZE clear of the
+ * tag bits, and block_size adds OVERHEAD to count them like a heap block.
+ *
+ * memlib cannot shrink the heap, so trimming releases the whole pages of
+ * a free block with madvise instead; its header, links and footer stay.
+ * Every arena remembers from where the pages of its top block are
+ * released (trimmed), and coalesce releases the rest once TRIM_THRESHOLD
+ * bytes of the top block hold resident pages.
+ *
+ * Heap memory past the highest break mem_sbrk ever returned is taken to
+ * be zero, as fresh sbrk or mmap pages are.  Every arena remembers from
+ * where (clean) its heap holds nothing but zeros up to the footer of its
+ * top block, and place tags a block cut from there ZEROED, so calloc
+ * only clears the bytes that held its free list links.  A heap block
+ * never has the MMAPPED bit otherwise, so the two share it.
+ *
+ * A block in a fast bin stays marked allocated, like a block in a thread
+ * cache, so its neighbours never coalesce with it; the first word of its
+ * payload links the bin.
+ *
  *
  * Free Block structure:
  *
@@ -32,27 +91,54 @@
  *               in chapter 9.9 in CSAPP textbook.
  * Prev-Pointer: 8-bytes, used to store the previous free block address
  * Next-Pointer: 8-bytes, used to store the next free block address
+ *               With COMPACT_LINKS both are 4-byte offsets from the
+ *               start of the heap (0 is NULL), which with ELIDE_FOOTERS
+ *               makes the minimum block 2*DSIZE.
+ *
+ *
+ * Allocated Block structure (ELIDE_FOOTERS):
+ *
+ * -----------------------------------------------------------------
+ * |header|                   payload                               |
+ * -----------------------------------------------------------------
+ * header:       4 bytes, bit 0 - this block is allocated
+ *                        bit 1 - the previous block is allocated
+ *               Only free blocks keep a footer, so coalesce reads
+ *               bit 1 instead of the footer of the previous block.
  *
  *
  * Principles:
  *
  *        Each blocks shall have a header and a footer which has
  *        the same structure with examples in chapter 9.9 in CSAPP
- *        textbook. All blocks shall be aligned to 8 bytes, and the
- *        minimum size of Block is 3*DSIZE. Free blocks are linked with
+ *        textbook (with ELIDE_FOOTERS, only free blocks have a footer).
+ *        All blocks shall be aligned to ALIGNMENT (16) bytes, and the
+ *        minimum size of Block is MINBLOCK. Free blocks are linked with
  *        each other in multiple free lists, where each list holds roughly
  *        the same size.
  *
  *
  *
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* sched_getcpu */
+#endif
 #include <assert.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include "mm.h"
+#include "mm_ext.h"
 #include "memlib.h"
 
 /* do not change the following! */
@@ -67,21 +153,288 @@
 #define Debugx
 /*define if user wants to enter verbose mode (1-verbose output;0-not)*/
 #define Verbose     0
-/* single word (4) or double word (8) alignment */
-#define ALIGNMENT 8
+/*
+ * define the number of operations of an arena between two full heap
+ * checks in debug mode; the others only check the blocks and free list
+ * heads they touched (1-check the whole heap on every operation)
+ */
+#ifndef CHECK_EVERY
+#define CHECK_EVERY 1024
+#endif
+/*
+ * define to 1 to drop the footer of allocated blocks and keep the
+ * previous block's allocation state in the header instead (0-classic
+ * header+footer layout)
+ */
+#ifndef ELIDE_FOOTERS
+#define ELIDE_FOOTERS 1
+#endif
+/*
+ * define to 1 to store free list links as 32-bit heap offsets instead of
+ * 8-byte pointers; the heap is then limited to MAXHEAP bytes
+ */
+#ifndef COMPACT_LINKS
+#define COMPACT_LINKS 1
+#endif
+/*
+ * define to 1 to keep recently freed small blocks in a per-thread cache;
+ * the shared free lists are then only touched (under an arena lock) once
+ * per batch of blocks moved between a thread and its arena
+ */
+#ifndef TCACHE
+#define TCACHE 1
+#endif
+/*
+ * number of arenas, and how threads are assigned to them
+ * (ARENA_ROUNDROBIN-each new thread takes the next arena;
+ *  ARENA_PERCPU-every slow path uses the arena of the current CPU)
+ */
+#ifndef NARENAS
+#define NARENAS 8
+#endif
+#define ARENA_ROUNDROBIN 0
+#define ARENA_PERCPU     1
+#ifndef ARENA_POLICY
+#define ARENA_POLICY ARENA_ROUNDROBIN
+#endif
+/*
+ * define to 1 to let a thread free a block of another thread's arena
+ * without its lock: the block is pushed on the arena's remote free queue
+ * and the arena frees it when it next allocates
+ */
+#ifndef REMOTE_FREE
+#define REMOTE_FREE 1
+#endif
+/*
+ * define to 1 to serve block sizes up to SLAB_MAXSIZE from slabs: pages
+ * of equal-sized objects without headers that are never split or
+ * coalesced
+ */
+#ifndef SLAB
+#define SLAB 1
+#endif
+/*
+ * define to 1 to map blocks of MMAP_THRESHOLD bytes and up directly from
+ * the OS, and unmap them as soon as they are freed
+ */
+#ifndef MMAP_LARGE
+#define MMAP_LARGE 1
+#endif
+#ifndef MMAP_THRESHOLD
+#define MMAP_THRESHOLD (128*1024)
+#endif
+/*
+ * where insertFree puts a block in lists INSERT_FROM and up
+ * (INSERT_LIFO-at the head; INSERT_ADDRESS-in address order;
+ *  INSERT_SIZE-in size order, then address order); lists SKIPLIST_FROM
+ * and up (at least 11) are also indexed by a skip list when ordered
+ */
+#define INSERT_LIFO    0
+#define INSERT_ADDRESS 1
+#define INSERT_SIZE    2
+#ifndef INSERT_POLICY
+#define INSERT_POLICY INSERT_LIFO
+#endif
+#ifndef INSERT_FROM
+#define INSERT_FROM 1
+#endif
+#ifndef SKIPLIST_FROM
+#define SKIPLIST_FROM 11
+#endif
+/*
+ * define to 1 to index the blocks of the last list (above LIST17) by a
+ * red-black tree on size and address, for an O(log n) best fit there
+ */
+#ifndef LARGE_TREE
+#define LARGE_TREE 1
+#endif
+/*
+ * how find_fit picks a free block (FIT_FIRST-first block that fits;
+ * FIT_BEST-smallest of the first FIT_PROBES blocks that fit;
+ * FIT_EXACT-a block of exactly the size asked for among the first
+ * FIT_PROBES that fit, else the first one), the default of mm_fit_policy
+ */
+#define FIT_FIRST 0
+#define FIT_BEST  1
+#define FIT_EXACT 2
+#ifndef FIT_POLICY
+#define FIT_POLICY FIT_FIRST
+#endif
+#ifndef FIT_PROBES
+#define FIT_PROBES 8
+#endif
+/*
+ * define to 1 to release the pages of the free block at the top of an
+ * arena once more than TRIM_THRESHOLD bytes of it are resident
+ */
+#ifndef HEAP_TRIM
+#define HEAP_TRIM 1
+#endif
+#ifndef TRIM_THRESHOLD
+#define TRIM_THRESHOLD (256*1024)
+#endif
+/*
+ * define to 1 to keep freed blocks of up to FASTBIN_MAXSIZE bytes (and
+ * above SLAB_MAXSIZE with SLAB) in per-arena bins without coalescing
+ * them; the bins are coalesced in bulk when no free block fits, or by
+ * mm_consolidate
+ */
+#ifndef FASTBINS
+#define FASTBINS 1
+#endif
+/*
+ * define to 1 to sample one allocation per PROFILE_RATE bytes on average,
+ * with its stack, for a heap profile written by mm_profile_dump
+ */
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+#ifndef PROFILE_RATE
+#define PROFILE_RATE (512*1024) /* Mean bytes between two samples */
+#endif
+/*
+ * define to 1 to grow arenas in whole, aligned huge pages of HUGEPAGE
+ * bytes advised for transparent huge pages, and to release free pages
+ * only in whole huge pages
+ */
+#ifndef HUGEPAGES
+#define HUGEPAGES 0
+#endif
+/*
+ * define to 1 to bind every arena to the NUMA node of the first thread
+ * it serves: the pages of each heap extension prefer that node, and
+ * allocations are counted as local or remote to the calling thread
+ */
+#ifndef NUMA
+#define NUMA 0
+#endif
+/* Alignment of every payload and block size: that of max_align_t */
+#define ALIGNMENT 16
 
 /* rounds up to the nearest multiple of ALIGNMENT */
-#define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~(size_t)(ALIGNMENT-1))
 #define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
 
 #define SIZE_PTR(p)  ((size_t*)(((char*)(p)) - SIZE_T_SIZE))
 /* Define the MAX memory the heap can have*/
-#define MAXHEAP (1<<32)
+#define MAXHEAP ((size_t)1<<32)
 #define WSIZE       4       /* Word and header/footer size (bytes) */
 #define DSIZE       8       /* Doubleword size (bytes) */
-#define CHUNKSIZE  168      /* Extend heap by this amount (bytes) */
-#define MAXFREESIZE 20      /* max number of freelists*/
+#ifndef CHUNKSIZE
+#define CHUNKSIZE  4096     /* Extend heap by at least this amount (bytes) */
+#endif
+#ifndef CHUNKMAX
+#define CHUNKMAX   (256*1024) /* Largest extension not asked for (bytes) */
+#endif
+/*
+ * An extension less than this many allocations per CHUNKSIZE bytes of
+ * the previous one after it doubles the next one
+ */
+#define CHUNKWINDOW 64
+#define MAXFREESIZE 18      /* max number of freelists (LIST1..LIST17 + 1)*/
+#if COMPACT_LINKS
+#define LINKSIZE    WSIZE   /* Size of one free list link */
+#else
+#define LINKSIZE    DSIZE
+#endif
+/* Header, both free list links and footer */
+#define MINBLOCK    ALIGN(2*LINKSIZE + DSIZE)
+#if ELIDE_FOOTERS
+#define OVERHEAD    WSIZE   /* Bytes of an allocated block not in payload */
+#define PREV_ALLOC  0x2     /* Header bit: the previous block is allocated */
+#else
+#define OVERHEAD    DSIZE
+#define PREV_ALLOC  0
+#endif
 #define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
+
+/* Mapping bytes of a mapped block before its payload, unless aligned */
+#define MMAP_OVERHEAD   ALIGNMENT
+/* Mapping bytes before the payload of the mapped block bp */
+#define MMAP_OFFSET(bp) GET((char *)(bp) - DSIZE)
+/* Length of the mapping of the mapped block bp */
+#define MMAP_LEN(bp)    (GET_SIZE(HDRP(bp)) + MMAP_OFFSET(bp))
+
+/* realloc shrinks a block in place once it can free this many bytes */
+#define REALLOC_SHRINK  (3*DSIZE)
+
+/* mm_malloc_batch carves at most this many bytes from one block */
+#define BATCH_BYTES     (64*1024)
+
+/* Regions: chunks double from REGION_CHUNK up to REGION_CHUNKMAX bytes */
+#define REGION_CHUNK    8192
+#define REGION_CHUNKMAX (64*1024)
+
+/* Thread cache: one LIFO bin per block size up to TCACHE_MAXSIZE */
+#define TCACHE_MAXSIZE  1024  /* Largest block size (bytes) cached */
+#define TCACHE_FILL     16    /* Blocks per bin before half are flushed */
+#define TCACHE_BATCH    8     /* Max blocks fetched by one refill */
+#define TCACHE_REFILL_BYTES 4096 /* Max bytes fetched by one refill */
+#define TCACHE_BINS     ((TCACHE_MAXSIZE - MINBLOCK) / ALIGNMENT + 1)
+#define TCACHE_BIN(size) (((size) - MINBLOCK) / ALIGNMENT)
+
+/*
+ * Fast bins: one LIFO bin per block size from FASTBIN_MINSIZE up to
+ * FASTBIN_MAXSIZE.  Slabs serve every size up to SLAB_MAXSIZE, so a
+ * binned block of that size would never be taken again.
+ */
+#define FASTBIN_MINSIZE (SLAB ? SLAB_MAXSIZE + ALIGNMENT : MINBLOCK)
+#define FASTBIN_MAXSIZE 512   /* Largest block size (bytes) binned */
+#define FASTBIN_BINS    ((FASTBIN_MAXSIZE - FASTBIN_MINSIZE) / ALIGNMENT + 1)
+/* Bin of a block size, FASTBIN_BINS or more if it has none */
+#define FASTBIN_BIN(size) ((size_t)((size) - FASTBIN_MINSIZE) / ALIGNMENT)
+/* Bit of fastbinmap that tells whether fast bin b is non-empty */
+#define FASTBIT(b)      ((uint64_t)1 << (b))
+
+/* Heap profile: a table of live samples, open addressed by block */
+#define PROFILE_SLOTS   16384 /* Samples kept at most, a power of 2 */
+#define PROFILE_DEPTH   32    /* Frames kept of a sampled stack */
+#define PROFILE_RECHECK (1L << 30) /* Bytes between looks while off */
+#define PROFILE_HASH(bp) ((size_t)((((uintptr_t)(bp) >> 3) * \
+                          0x9e3779b97f4a7c15u) >> 32) & (PROFILE_SLOTS - 1))
+/* Whether prof_pages counts the page of bp, and its count: changed under
+   prof_lock, but read by profile_free without it, so accessed atomically */
+#define PROFILE_PAGED(bp) ((uintptr_t)(bp) - (uintptr_t)heap_base < MAXHEAP)
+#define PROFILE_PAGE(bp) \
+    prof_pages[((uintptr_t)(bp) >> PAGESHIFT) - pagemap_base]
+
+/* Bytes of a cache line: arenas are aligned to it */
+#define CACHELINE       64
+#define CACHE_ALIGN(p)  (((size_t)(p) + CACHELINE - 1) & ~(size_t)(CACHELINE-1))
+
+/* Page map: index of the arena owning each heap page, and slab flag */
+#define PAGEMAP         (NARENAS > 1 || SLAB)
+#define PAGESHIFT       12
+#define PAGESIZE        (1 << PAGESHIFT)
+#define PAGE_ALIGN(p)   (((size_t)(p) + PAGESIZE - 1) & ~(size_t)(PAGESIZE-1))
+#define PAGE_DOWN(p)    ((size_t)(p) & ~(size_t)(PAGESIZE-1))
+/* Arenas grow, and free pages are released, in units of GROWSIZE */
+#define HUGEPAGE        (2*1024*1024)
+#define GROWSIZE        (HUGEPAGES ? HUGEPAGE : PAGESIZE)
+#define GROW_ALIGN(p)   (((size_t)(p) + GROWSIZE - 1) & ~(size_t)(GROWSIZE-1))
+#define GROW_DOWN(p)    ((size_t)(p) & ~(size_t)(GROWSIZE-1))
+#define PAGEMAP_SIZE    (MAXHEAP >> PAGESHIFT) /* Bytes, one per page */
+#define PAGEMAP_AT(p)   pagemap[((uintptr_t)(p) >> PAGESHIFT) - pagemap_base]
+/* Bytes of segment overhead: link word, prologue and epilogue */
+#define SEGOVERHEAD     (2*DSIZE)
+/* Header value of every prologue block */
+#define PROLOGUE        PACK(DSIZE, 1)
+#define SLABPAGE        0x80  /* Page map flag of a slab page */
+
+/* NUMA: mbind(2) of linux/mempolicy.h, without libnuma */
+#define NUMA_PREFERRED  1     /* MPOL_PREFERRED */
+#define NUMA_MAXNODE    (8 * (int)sizeof(unsigned long)) /* One mask word */
+#define NUMA_RECHECK    64    /* Calls between looking up a thread's node */
+#define PAGEMAP_ARENA(v) (SLAB ? (v) & (SLABPAGE - 1) : (v))
+
+/* Slabs: one page of objects per slab, one class per block size */
+#define SLABSIZE        PAGESIZE
+#define SLAB_MAXSIZE    128   /* Largest block size (bytes) in slabs */
+#define SLAB_CACHE      4     /* Empty slabs an arena keeps for reuse */
+#define SLAB_CLASSES    ((SLAB_MAXSIZE - MINBLOCK) / ALIGNMENT + 1)
+#define SLAB_CLASS(size) (((size) - MINBLOCK) / ALIGNMENT)
+#define SLAB_OF(bp)     ((struct slab *)((size_t)(bp) & ~(size_t)(SLABSIZE-1)))
 
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc)  ((size) | (alloc))
@@ -92,10 +445,27 @@
 /* Read and write a 8-bytes pointer to address p*/
 #define PUTLP(p, val) (*(void **)(p) =(void *)(val) )
 #define GETLP(p)      (*(void **)(p))
+/*
+ * Read and write a header word another thread may read or write without
+ * the lock of its arena: the owner of an allocated block reads its header
+ * unlocked (free, realloc, calloc) while the lock holder of the arena
+ * flips its PREV_ALLOC bit.  The bits the owner reads never change then,
+ * but the accesses must be atomic all the same.
+ */
+#define GET_SHARED(p)      __atomic_load_n((unsigned int *)(p), __ATOMIC_RELAXED)
+#define PUT_SHARED(p, val) __atomic_store_n((unsigned int *)(p), (val), \
+                                            __ATOMIC_RELAXED)
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define MMAPPED      0x4 /* Header bit: the block is mapped on its own */
+/* Header bit of a heap block as place leaves it: zero past FREEHEAD bytes */
+#define ZEROED       MMAPPED
+#define GET_PREV_ALLOC(p) (GET(p) & PREV_ALLOC)
+/* Set or clear the previous-allocated bit of the header at address p */
+#define SET_PREV_ALLOC(p) PUT_SHARED(p, GET(p) | PREV_ALLOC)
+#define CLR_PREV_ALLOC(p) PUT_SHARED(p, GET(p) & ~PREV_ALLOC)
 
 /* Given block ptr bp, compute address of its header and footer */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)
@@ -104,450 +474,3191 @@
 /* Given block ptr bp, compute address of next and previous blocks */
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
-#define NEXT_FREE(bp)  ((void *) (*(unsigned int **)((char*)bp+DSIZE)))
-#define PREV_FREE(bp)  ((void *) (*(unsigned int **)(bp)))
+/* Whether the block before bp is allocated (PREV_BLKP needs it free) */
+#if ELIDE_FOOTERS
+#define PREV_ALLOCATED(bp) GET_PREV_ALLOC(HDRP(bp))
+#else
+#define PREV_ALLOCATED(bp) GET_ALLOC((char *)(bp) - DSIZE)
+#endif
+
+/* Read and write a free list link at address p */
+#if COMPACT_LINKS
+#define GET_LINK(p)    (GET(p) ? (void *)(heap_base + GET(p)) : NULL)
+#define PUT_LINK(p, val) \
+    PUT(p, (val) ? (unsigned int)((char *)(val) - heap_base) : 0)
+#else
+#define GET_LINK(p)    GETLP(p)
+#define PUT_LINK(p, val) PUTLP(p, val)
+#endif
+/* Given free block ptr bp, read and write its free list neighbours */
+#define NEXT_FREE(bp)  GET_LINK((char *)(bp) + LINKSIZE)
+#define PREV_FREE(bp)  GET_LINK(bp)
+#define SET_NEXT_FREE(bp, val) PUT_LINK((char *)(bp) + LINKSIZE, val)
+#define SET_PREV_FREE(bp, val) PUT_LINK(bp, val)
 /* $end mallocmacros */
 /* Free the block header and footer*/
 #define FREE_SIZE(bp)  (GET(bp) & ~0x1)
-/* Define the free block size (DSIZE) each free list has*/
-#define LIST1    3
+/*
+ * Define the free block size (DSIZE) each free list has.  Block sizes
+ * are multiples of ALIGNMENT, an even number of units, so the default
+ * bounds are even.  Build with
+ * -DSIZECLASS_FILE='"file.h"' to take LIST1..LIST17, SMALLCLASS_MAX,
+ * SMALLCLASS_LOG2 and SIZECLASS_TABLE from a file mm_classgen made for a
+ * size histogram of the workload instead.
+ */
+#ifdef SIZECLASS_FILE
+#include SIZECLASS_FILE
+#else
+#define LIST1    2
 #define LIST2    4
-#define LIST3    5
-#define LIST4    6
-#define LIST5    7
-#define LIST6    8
-#define LIST7    9
-#define LIST8    10
-#define LIST9    12
-#define LIST10   16
-#define LIST11   32
-#define LIST12   64
-#define LIST13   128
-#define LIST14   256
-#define LIST15   512
-#define LIST16   1024
-#define LIST17   2048
+#define LIST3    6
+#define LIST4    8
+#define LIST5    10
+#define LIST6    12
+#define LIST7    14
+#define LIST8    16
+#define LIST9    24
+#define LIST10   32
+#define LIST11   64
+#define LIST12   128
+#define LIST13   256
+#define LIST14   512
+#define LIST15   1024
+#define LIST16   2048
+#define LIST17   4096
+#endif
+/* Bit of freelistbitmap that tells whether free list n is non-empty */
+#define LISTBIT(n)  (1u << ((n) - 1))
+
+/*
+ * Skip list of an ordered list: level 0 is the list itself, a node of
+ * level L is also linked on levels 1..L-1 through links after the list
+ * links, and the level is kept in the word in front of them.
+ */
+#define SKIP_LEVELS 8
+#define SKIP_LISTS  (MAXFREESIZE - SKIPLIST_FROM + 1)
+#define SKIP_LEVELP(bp)   ((char *)(bp) + 2*LINKSIZE)
+#define SKIP_LINKP(bp, l) ((char *)(bp) + (2 + (l)) * LINKSIZE)
+#if INSERT_POLICY == INSERT_LIFO
+#define SKIPHEAD    0
+#else
+#define SKIPHEAD    ((SKIP_LEVELS + 2) * LINKSIZE)
+#endif
+
+/*
+ * Tree node of a block of the last list, after its list links: left and
+ * right child, parent, then the color in a word.  The list stays threaded
+ * through the nodes in order.
+ */
+#define TREE_LEFTP(bp)   ((char *)(bp) + 2*LINKSIZE)
+#define TREE_RIGHTP(bp)  ((char *)(bp) + 3*LINKSIZE)
+#define TREE_PARENTP(bp) ((char *)(bp) + 4*LINKSIZE)
+#define TREE_COLORP(bp)  ((char *)(bp) + 5*LINKSIZE)
+#define TREE_LEFT(bp)    GET_LINK(TREE_LEFTP(bp))
+#define TREE_RIGHT(bp)   GET_LINK(TREE_RIGHTP(bp))
+#define TREE_PARENT(bp)  GET_LINK(TREE_PARENTP(bp))
+#define TREEHEAD    (LARGE_TREE ? 5 * LINKSIZE + WSIZE : 0)
+/* Payload bytes a free block needs kept */
+#define FREEHEAD    MAX(MINBLOCK, MAX(SKIPHEAD, TREEHEAD))
+
+/*
+ * Size class engine: LIST1..LIST17 above are the only definition of the
+ * class bounds.  A block of u DSIZE units belongs to the first list whose
+ * bound is >= u, and everything above LIST17 goes to list MAXFREESIZE.
+ * SIZECLASS_OF is the reference mapping as a constant expression; it is
+ * only used to generate the lookup table below at compile time.
+ */
+#define SIZECLASS_OF(u) \
+    ((u) <= LIST1  ?  1 : (u) <= LIST2  ?  2 : (u) <= LIST3  ?  3 : \
+     (u) <= LIST4  ?  4 : (u) <= LIST5  ?  5 : (u) <= LIST6  ?  6 : \
+     (u) <= LIST7  ?  7 : (u) <= LIST8  ?  8 : (u) <= LIST9  ?  9 : \
+     (u) <= LIST10 ? 10 : (u) <= LIST11 ? 11 : (u) <= LIST12 ? 12 : \
+     (u) <= LIST13 ? 13 : (u) <= LIST14 ? 14 : (u) <= LIST15 ? 15 : \
+     (u) <= LIST16 ? 16 : (u) <= LIST17 ? 17 : MAXFREESIZE)
 
+/* Blocks up to SMALLCLASS_MAX units are mapped through sizeclass_table[] */
+#ifndef SMALLCLASS_MAX
+#define SMALLCLASS_MAX   LIST10
+#define SMALLCLASS_LOG2  5          /* log2(LIST10) */
+#endif
+/* ceil(log2(u)) for u > 1 */
+#define CEIL_LOG2(u)     (32 - __builtin_clz((unsigned int)(u) - 1))
+
+/*
+ * The bounds rise, SMALLCLASS_MAX is a power of 2 and one of them, and
+ * every bound above it doubles, so the class follows directly from the
+ * bit length of u.  Refuse to compile otherwise.
+ */
+#define SIZECLASS_NEXT(lo, hi) \
+    ((lo) < (hi) && ((hi) <= SMALLCLASS_MAX || (hi) == 2*(lo)))
+typedef char sizeclass_bounds_are_geometric[
+    (SMALLCLASS_MAX == (1 << SMALLCLASS_LOG2) &&
+     SIZECLASS_OF(SMALLCLASS_MAX + 1) == SIZECLASS_OF(SMALLCLASS_MAX) + 1 &&
+     LIST1 >= 1 && SIZECLASS_NEXT(LIST1, LIST2) &&
+     SIZECLASS_NEXT(LIST2, LIST3) && SIZECLASS_NEXT(LIST3, LIST4) &&
+     SIZECLASS_NEXT(LIST4, LIST5) && SIZECLASS_NEXT(LIST5, LIST6) &&
+     SIZECLASS_NEXT(LIST6, LIST7) && SIZECLASS_NEXT(LIST7, LIST8) &&
+     SIZECLASS_NEXT(LIST8, LIST9) && SIZECLASS_NEXT(LIST9, LIST10) &&
+     SIZECLASS_NEXT(LIST10, LIST11) && SIZECLASS_NEXT(LIST11, LIST12) &&
+     SIZECLASS_NEXT(LIST12, LIST13) && SIZECLASS_NEXT(LIST13, LIST14) &&
+     SIZECLASS_NEXT(LIST14, LIST15) && SIZECLASS_NEXT(LIST15, LIST16) &&
+     SIZECLASS_NEXT(LIST16, LIST17) &&
+     SIZECLASS_OF(LIST17 + 1) == MAXFREESIZE) ? 1 : -1];
+
+/*
+ * A generated SIZECLASS_TABLE is the same mapping, written out.  The
+ * default table is written out to 32 units; either must have exactly an
+ * entry per unit up to SMALLCLASS_MAX, or the lookup would read past it
+ * or miss classes.  Refuse to compile otherwise.
+ */
+#ifdef SIZECLASS_TABLE
+static const unsigned char sizeclass_table[] = SIZECLASS_TABLE;
+#else
+#define SC4(u) SIZECLASS_OF(u), SIZECLASS_OF((u)+1), \
+               SIZECLASS_OF((u)+2), SIZECLASS_OF((u)+3)
+static const unsigned char sizeclass_table[] = {
+    SC4(0), SC4(4), SC4(8), SC4(12), SC4(16), SC4(20), SC4(24), SC4(28),
+    SIZECLASS_OF(32)
+};
+#endif
+typedef char sizeclass_table_covers_small_classes[
+    (sizeof(sizeclass_table) == SMALLCLASS_MAX + 1) ? 1 : -1];
 
 
 /* Global variables */
-static char *heap_listp = 0;  /* Pointer to first block */
-void *freelisthead = 0;       /*Pointer to free list head*/
-void *freelisttablehead = 0 ;/*Pointer to free list table head*/
+static char *heap_base = 0;   /* mem_heap_lo(), base of heap offsets */
+static char *heap_fresh = 0;  /* Heap from here up never handed out */
+/* mem_heap_hi() + 1, stored under sbrk_lock and read without it */
+static char *heap_end = 0;
+
+/*
+ * Arena: an independent heap made of one or more segments, with its own
+ * segregated free lists and lock.  The table of all NARENAS arenas lives
+ * in Zone <1>; an arena gets its first segment when it is first used.
+ * Arenas start on a cache line, and what find_fit reads of one (the
+ * bitmap, the sizes of the list heads and the heads) follows the lock
+ * in the first lines, so a search only touches blocks once a head may
+ * fit.
+ */
+struct arena {
+    pthread_mutex_t lock;          /* Guards the arena and its blocks */
+    unsigned int index;            /* Position in the arena table */
+    unsigned int freelistbitmap;   /* LISTBIT(n) set: list n not empty */
+    unsigned int headsize[MAXFREESIZE]; /* Size of each list head, or 0 */
+    void *freelist[MAXFREESIZE];   /* Head of each free list */
+    char *lastseg;                 /* Start of the newest segment */
+    char *top;                     /* End of the newest segment */
+    void *remote;                  /* Remote free queue, pushed with CAS */
+    char *trimmed;                 /* Top block pages released from here */
+    char *clean;                   /* Heap zero from here to the top */
+    size_t chunk;                  /* Size of the last extension */
+    unsigned long nmalloc;         /* Blocks allocated so far */
+    unsigned long lastextend;      /* nmalloc at the last extension */
+    struct slab *slabs[SLAB_CLASSES]; /* Slabs with free objects */
+    struct slab *slabcache;        /* Empty slabs kept for new ones */
+    unsigned int nslabcache;       /* Slabs in slabcache */
+    uint64_t fastbinmap;           /* FASTBIT(b) set: fast bin b not empty */
+    void *fastbin[FASTBIN_BINS];   /* Head of each fast bin */
+    #if INSERT_POLICY != INSERT_LIFO
+    void *skip[SKIP_LISTS][SKIP_LEVELS-1]; /* Heads of skip list levels */
+    unsigned int seed;             /* Draws skip list levels */
+    #endif
+    void *tree;                    /* Root of the last list's tree */
+    struct mm_stats stats;         /* Counters, summed by mm_stats */
+    unsigned int touched;          /* LISTBIT(n): list n changed (Debug) */
+    unsigned long nchecks;         /* Operations checked (Debug) */
+    int node;                      /* NUMA node bound to, -1 for none */
+} __attribute__((aligned(CACHELINE)));
+
+/*
+ * Slab header, at the start of the slab page.  Freed objects form a LIFO
+ * stack through their first word; objects never handed out yet are cut
+ * from bump on demand.
+ */
+struct slab {
+    struct slab *next, *prev;      /* Arena list of non-full slabs */
+    void *freeobj;                 /* Top of the free object stack */
+    char *bump;                    /* First never used object */
+    unsigned int size;             /* Block size of every object */
+    unsigned int nobjs;            /* Objects in the slab */
+    unsigned int nfree;            /* Objects free or never used */
+};
+#define SLAB_FIRST      ALIGN(sizeof(struct slab)) /* Offset of object 0 */
+
+/*
+ * Region: chunks obtained with malloc, the newest regular chunk
+ * (current) cut by a bump pointer.  Objects have no header; the chunks
+ * are freed only by mm_region_reset and mm_region_destroy.  A region is
+ * not locked, so it is used by one thread at a time.
+ */
+struct region_chunk {
+    struct region_chunk *next;     /* Next chunk of the region */
+    size_t size;                   /* Bytes after the chunk header */
+};
+#define REGION_FIRST    ALIGN(sizeof(struct region_chunk)) /* Bytes start */
+struct mm_region {
+    struct region_chunk *chunks;   /* All chunks, current first */
+    struct region_chunk *current;  /* Chunk bump cuts, NULL at first */
+    char *bump;                    /* Next free byte of current */
+    char *limit;                   /* End of current */
+    size_t chunk;                  /* Size of the next regular chunk */
+};
+static struct arena *arenas = NULL;     /* Table of NARENAS arenas */
+#if PAGEMAP
+static unsigned char *pagemap = NULL;   /* Page map */
+#endif
+static uintptr_t pagemap_base = 0;      /* Page number of heap_base */
+/* Guards mem_sbrk, the page map and the arena table */
+static pthread_mutex_t sbrk_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int heap_gen = 0; /* Bumped by mm_init, voids old caches */
+static struct mm_stats map_stats; /* Mapped block counters, atomic */
+/* Live and peak bytes of all arenas at once, atomic */
+static struct mm_stats live_stats;
+static unsigned int arena_next = 0;     /* Next arena for ARENA_ROUNDROBIN */
+static int fit_policy = FIT_POLICY;     /* Set by mm_fit_policy */
+static int fit_probes = FIT_PROBES;
+#if ARENA_POLICY == ARENA_ROUNDROBIN
+static __thread struct arena *thread_arena = NULL;
+static __thread unsigned int thread_arena_gen = 0;
+#endif
+#if NUMA
+static __thread int thread_node = -1;   /* NUMA node of the thread */
+static __thread unsigned int thread_node_age = 0; /* Calls until rechecked */
+#endif
+
+typedef char skip_nodes_fit_in_blocks[
+    (SKIPLIST_FROM >= 11 && LIST10 * DSIZE >= FREEHEAD) ? 1 : -1];
+typedef char narenas_fit_in_pagemap[
+    (NARENAS >= 1 && NARENAS <= (SLAB ? SLABPAGE : 256)) ? 1 : -1];
+typedef char fastbins_fit_in_bitmap[(FASTBIN_BINS <= 64) ? 1 : -1];
+typedef char fastbins_above_slabs[
+    (FASTBIN_MAXSIZE >= FASTBIN_MINSIZE &&
+     (!SLAB || FASTBIN_MINSIZE > SLAB_MAXSIZE)) ? 1 : -1];
+typedef char stats_count_every_list[(MM_STATS_LISTS == MAXFREESIZE) ? 1 : -1];
+typedef char mm_alignment_is_alignment[(MM_ALIGNMENT == ALIGNMENT) ? 1 : -1];
+
+#if TCACHE
+/*
+ * Thread cache, carved from the heap on first use by each thread.
+ * Cached blocks stay marked allocated; the first word of the payload
+ * links them into the bin of their block size.  The blocks got and put
+ * are counted per list like in an arena, and the counts are moved into
+ * the arena stats whenever the cache holds an arena lock.
+ */
+struct tcache {
+    unsigned int gen;                  /* heap_gen the blocks came from */
+    unsigned int count[TCACHE_BINS];   /* Blocks held in each bin */
+    void *bin[TCACHE_BINS];            /* Head of each bin */
+    unsigned long hits, puts;          /* Blocks got and put in bins */
+    unsigned long nmalloc[MAXFREESIZE]; /* Blocks got, per list */
+    unsigned long nfree[MAXFREESIZE];  /* Blocks put, per list */
+};
+static __thread struct tcache *tcache = NULL;
+static pthread_key_t tcache_key;       /* Flushes the cache at thread exit */
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+#endif
+
+#if PROFILE
+/*
+ * Heap profile sample: a live block the byte countdown of its thread
+ * picked, with the stack that allocated it.  A heap page counts the
+ * samples in it, so free only searches the table for blocks of pages
+ * holding one (a count of 255 sticks).
+ */
+struct prof_sample {
+    void *bp;                      /* Sampled block, NULL for a free slot */
+    size_t size;                   /* Bytes asked for */
+    int depth;                     /* Frames in stack */
+    void *stack[PROFILE_DEPTH];    /* Return addresses, innermost first */
+};
+static struct prof_sample *prof_table = NULL; /* PROFILE_SLOTS, mapped */
+static unsigned char *prof_pages = NULL; /* Samples in each heap page */
+static unsigned long prof_nlive = 0;     /* Samples in the table */
+static size_t prof_rate = PROFILE_RATE;  /* Set by mm_profile, 0 is off */
+/* Guards the table and the page counts */
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread long prof_countdown = 0; /* Bytes to the next sample */
+static __thread unsigned int prof_seed = 0; /* Draws the countdowns */
+static __thread int prof_busy = 0;       /* Sampling: backtrace mallocs */
+#endif
 
 
 /* Function prototypes for internal helper routines */
-static void *extend_heap(size_t words);
-static void place(void *bp, size_t asize);
-static void *find_fit(size_t asize);
-static void *coalesce(void *bp);
+static void *profile_alloc(void *bp, size_t size);
+static void profile_free(void *bp);
+static void *profile_resize(void *oldptr, void *newptr, size_t size);
+#if PROFILE
+static void profile_sample(void *bp, size_t size);
+static void profile_forget(void *bp);
+static long profile_interval(size_t rate);
+static void profile_reset(void);
+#endif
+static void *extend_heap(struct arena *ar, size_t words);
+static void place(struct arena *ar, void *bp, size_t asize);
+static void *find_fit(struct arena *ar, size_t asize);
+static void *coalesce(struct arena *ar, void *bp);
 static void printblock(void *bp);
 static void checkblock(void *bp);
 static int choosefreetable(void *bp);
-static int choosefreetable_bysize(int freeblksize);
+static int choosefreetable_bysize(size_t freeblksize);
+static size_t adjust_size(size_t size);
+static int heap_init(void);
+static struct arena *arena_choose(void);
+static struct arena *arena_of(void *bp);
+#if NUMA
+static int numa_node(void);
+static void numa_bind(struct arena *ar, char *lo, char *hi);
+#endif
+static void *malloc_block(struct arena *ar, size_t asize);
+static size_t malloc_batch(size_t size, void **ptrs, size_t n);
+static void *malloc_aligned_block(struct arena *ar, size_t align,
+                                  size_t asize);
+static void trim_block(struct arena *ar, void *bp, size_t asize);
+static int resize_block(struct arena *ar, void *bp, size_t asize);
+static void free_block(struct arena *ar, void *bp);
+static void merge_block(struct arena *ar, void *bp);
+static void live_add(size_t size);
+#if FASTBINS
+static void fastbin_consolidate(struct arena *ar);
+#endif
+static size_t block_size(void *bp);
+static int in_heap(const void *p);
+#if MMAP_LARGE
+static void *mmap_block(size_t size);
+static void *mmap_aligned_block(size_t align, size_t size);
+static void *mremap_block(void *bp, size_t size);
+static void munmap_block(void *bp);
+static void mapped_add(size_t size);
+#endif
+#if SLAB
+static void *slab_alloc(struct arena *ar, size_t asize);
+static void slab_free(struct arena *ar, void *bp);
+static void slab_uncache(struct arena *ar);
+#endif
+static void arena_free(void *bp);
+static void *region_grow(struct mm_region *rg, size_t alignment,
+                         size_t size);
+static void remote_drain(struct arena *ar);
+static int checkheap(struct arena *ar, int verbose);
+#ifdef Debug
+static void checkop(struct arena *ar, void *bp);
+static void checklocal(struct arena *ar, void *bp);
+#endif
+static size_t release_block(void *bp, size_t pad, char *limit);
+#ifdef Debug
+static void checksize(void *bp, size_t asize);
+#endif
+#if defined(Debug) && MMAP_LARGE
+static void checkmapped(void *bp);
+#endif
+#if TCACHE
+static void checktcache(void);
+#endif
+#if LARGE_TREE
+static int checktree(void *x, void *parent);
+static int treesize(void *x);
+#endif
+#if TCACHE
+static void *tcache_get(size_t asize);
+static void tcache_put(void *bp, size_t size);
+static void tcache_stats(struct tcache *tc, struct arena *ar);
+#endif
 
 /*
  * Initialize: return -1 on error, 0 on success.
  */
 int mm_init(void) {
+    int result;
+    pthread_mutex_lock(&sbrk_lock);
+    result = heap_init();
+    pthread_mutex_unlock(&sbrk_lock);
+    if (result == 0)
+    {
+        /* Extend the empty heap with a free block of CHUNKSIZE bytes */
+        pthread_mutex_lock(&arenas[0].lock);
+        if (extend_heap(&arenas[0], CHUNKSIZE/WSIZE) == NULL)
+            result = -1;
+        pthread_mutex_unlock(&arenas[0].lock);
+    }
+    return result;
+}
+
+/*
+ * heap_init - create Zone <1> with empty arenas, sbrk_lock held
+ */
+static int heap_init(void) {
     /* Create the initial empty heap */
-    size_t freeslistnum;
+    size_t tablesize, pad;
+    char *table, *brk;
     int i;
-    freeslistnum = DSIZE*((MAXFREESIZE*DSIZE + DSIZE + DSIZE -1)/DSIZE);
-    freelisttablehead = (char*)mem_sbrk(freeslistnum)+DSIZE;
-    PUT(HDRP(freelisttablehead),PACK(freeslistnum,1));
-    PUT(FTRP(freelisttablehead),PACK(freeslistnum,1));
-    for (i = 0;i<MAXFREESIZE;i++)
+    heap_gen++;
+    arena_next = 0;
+    __atomic_store_n(&live_stats.live, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&live_stats.peak, 0, __ATOMIC_RELAXED);
+    /* mem_reset_brk leaves the old heap behind, used */
+    if (heap_base != mem_heap_lo())
+        heap_fresh = (char *)mem_heap_hi() + 1;
+    heap_base = mem_heap_lo();
+    pagemap_base = (uintptr_t)heap_base >> PAGESHIFT;
+    #if PROFILE
+    profile_reset();
+    #endif
+    #if PAGEMAP
+    /* Map the page map once; a later mm_init just zeroes it */
+    if (pagemap == NULL)
     {
-        PUTLP(((char*)freelisttablehead+i*DSIZE),NULL);
+        pagemap = mmap(NULL, PAGEMAP_SIZE, PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (pagemap == MAP_FAILED)
+        {
+            pagemap = NULL;
+            return -1;
+        }
     }
-
-    if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1)
-	    return -1;
-    PUT(heap_listp, 0);                          /* Alignment padding */
-    PUT(heap_listp + (1*WSIZE), PACK(DSIZE, 1)); /* Prologue header */
-    PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1)); /* Prologue footer */
-    PUT(heap_listp + (3*WSIZE), PACK(0, 1));     /* Epilogue header */
-    heap_listp += (2*WSIZE);
-    /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-    if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
+    else
+        madvise(pagemap, PAGEMAP_SIZE, MADV_DONTNEED);
+    #endif
+    tablesize = ALIGN(NARENAS * sizeof(struct arena));
+    /* padding to a cache line, header, the table and its footer, padding */
+    brk = (char *)mem_heap_hi() + 1;
+    pad = CACHE_ALIGN(brk + DSIZE) - (size_t)(brk + DSIZE);
+    if ((table = mem_sbrk(pad + tablesize + 2*DSIZE)) == (void *)-1)
 	    return -1;
+    heap_fresh = MAX(heap_fresh, (char *)mem_heap_hi() + 1);
+    __atomic_store_n(&heap_end, (char *)mem_heap_hi() + 1, __ATOMIC_RELAXED);
+    table += pad + DSIZE;
+    PUT(HDRP(table),PACK(tablesize + DSIZE,1));
+    PUT(FTRP(table),PACK(tablesize + DSIZE,1));
+    memset(table, 0, tablesize);
+    for (i = 0;i<NARENAS;i++)
+    {
+        pthread_mutex_init(&((struct arena *)table)[i].lock, NULL);
+        ((struct arena *)table)[i].index = i;
+        ((struct arena *)table)[i].node = -1;
+        #if INSERT_POLICY != INSERT_LIFO
+        ((struct arena *)table)[i].seed = 2463534242u + i;
+        #endif
+    }
+    __atomic_store_n(&arenas, (struct arena *)table, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * arena_choose - the arena serving the calling thread, creating the
+ *                heap on first use.  NULL, with errno ENOMEM, if the heap
+ *                cannot be created.
+ */
+static struct arena *arena_choose(void)
+{
+    if (__atomic_load_n(&arenas, __ATOMIC_ACQUIRE) == NULL)
+    {
+        pthread_mutex_lock(&sbrk_lock);
+        if (arenas == NULL)
+            heap_init();
+        pthread_mutex_unlock(&sbrk_lock);
+        if (arenas == NULL)
+        {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    #if ARENA_POLICY == ARENA_PERCPU
+    {
+        int cpu = sched_getcpu();
+        struct arena *ar = &arenas[cpu < 0 ? 0 : cpu % NARENAS];
+        #if NUMA
+        /* The first thread on the arena's CPUs picks its node */
+        if (__atomic_load_n(&ar->node, __ATOMIC_RELAXED) < 0)
+            __atomic_store_n(&ar->node, numa_node(), __ATOMIC_RELAXED);
+        #endif
+        return ar;
+    }
+    #else
+    if (thread_arena == NULL || thread_arena_gen != heap_gen)
+    {
+        thread_arena = &arenas[__atomic_fetch_add(&arena_next, 1,
+                                   __ATOMIC_RELAXED) % NARENAS];
+        thread_arena_gen = heap_gen;
+        #if NUMA
+        /* The first thread assigned to the arena picks its node */
+        {
+            int unbound = -1;
+            __atomic_compare_exchange_n(&thread_arena->node, &unbound,
+                                        numa_node(), 0, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED);
+        }
+        #endif
+    }
+    return thread_arena;
+    #endif
+}
 
+#if NUMA
+/*
+ * numa_node - NUMA node of the calling thread, looked up again every
+ *             NUMA_RECHECK calls as the thread may migrate.  -1 if
+ *             unknown.
+ */
+static int numa_node(void)
+{
+    unsigned int cpu, node;
+
+    if (thread_node_age-- == 0)
+    {
+        thread_node = getcpu(&cpu, &node) == 0 ? (int)node : -1;
+        thread_node_age = NUMA_RECHECK - 1;
+    }
+    return thread_node;
+}
+
+/*
+ * numa_bind - make the pages from lo to hi of arena ar prefer its node.
+ *             Best effort: without NUMA support mbind fails and the
+ *             pages come from wherever the OS puts them.
+ */
+static void numa_bind(struct arena *ar, char *lo, char *hi)
+{
+    unsigned long mask;
+    int node = __atomic_load_n(&ar->node, __ATOMIC_RELAXED);
+
+    lo = (char *)PAGE_DOWN(lo);
+    if (node < 0 || node >= NUMA_MAXNODE || lo >= hi)
+        return;
+    mask = 1UL << node;
+    syscall(SYS_mbind, lo, (size_t)(hi - lo), NUMA_PREFERRED, &mask,
+            NUMA_MAXNODE + 1, 0);
+}
+#endif
+
+/*
+ * arena_of - the arena owning block bp, found through the page map
+ */
+static inline struct arena *arena_of(void *bp)
+{
+    #if NARENAS > 1
+    return &arenas[PAGEMAP_ARENA(PAGEMAP_AT(bp))];
+    #else
+    (void)bp;
+    return &arenas[0];
+    #endif
+}
+
+/*
+ * is_slab - whether bp is an object of a slab rather than a block
+ */
+static inline int is_slab(void *bp)
+{
+    #if SLAB
+    return PAGEMAP_AT(bp) & SLABPAGE;
+    #else
+    (void)bp;
     return 0;
+    #endif
+}
+
+/*
+ * is_mmapped - whether bp is a mapped block.  The address is checked
+ *              first: the word before a heap object may be the data of a
+ *              slab object, or the header of a block of another thread.
+ */
+static inline int is_mmapped(void *bp)
+{
+    return MMAP_LARGE && !in_heap(bp) && (GET(HDRP(bp)) & MMAPPED);
+}
+
+/*
+ * block_size - size of the allocated block, slab object or mapped
+ *              block bp
+ */
+static inline size_t block_size(void *bp)
+{
+    if (is_mmapped(bp))
+        return GET_SIZE(HDRP(bp)) + OVERHEAD;
+    if (is_slab(bp))
+        return SLAB_OF(bp)->size;
+    return GET_SHARED(HDRP(bp)) & ~0x7;
 }
 
 
 /*
  * malloc- Allocate memory large enough to store size bytes
  *         align the size inside this function to make sure:
- *         1-at least 3* DSIZE bytes for each block
- *         2- Align to DSIZE bytes
+ *         1-at least MINBLOCK bytes for each block
+ *         2- Align to ALIGNMENT bytes
+ *         Small blocks come from the thread cache when possible.
  */
 void *malloc (size_t size) {
     size_t asize;      /* Adjusted block size */
-    size_t extendsize; /* Amount to extend heap if no fit */
     char *bp;
+    struct arena *ar;
 
-    if (heap_listp == 0){
-	    mm_init();
-    }
     /* Ignore spurious requests */
     if (size == 0)
 	    return NULL;
 
     /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)
-	    asize = 3*DSIZE; //at least 3*DSIZE for each block
+    if ((asize = adjust_size(size)) == 0)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    #if MMAP_LARGE
+    if (asize >= MMAP_THRESHOLD)
+        return profile_alloc(mmap_block(size), size);
+    #endif
+    #if TCACHE
+    if (asize <= TCACHE_MAXSIZE)
+        return profile_alloc(tcache_get(asize), size);
+    #endif
+
+    if ((ar = arena_choose()) == NULL)
+        return NULL;
+    pthread_mutex_lock(&ar->lock);
+    bp = malloc_block(ar, asize);
+    pthread_mutex_unlock(&ar->lock);
+    return profile_alloc(bp, size);
+}
+
+/*
+ * malloc_block - find or make room for a block of asize bytes
+ *                and allocate it, ar->lock held
+ */
+static void *malloc_block(struct arena *ar, size_t asize)
+{
+    size_t extendsize; /* Amount to extend heap if no fit */
+    char *bp;
+
+    ar->nmalloc++;
+    ar->stats.nmalloc[choosefreetable_bysize(asize) - 1]++;
+    #if NUMA
+    if (__atomic_load_n(&ar->node, __ATOMIC_RELAXED) == numa_node() &&
+        ar->node >= 0)
+        ar->stats.nlocal++;
     else
-	    asize = DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
-	    // Size Adjust
+        ar->stats.nremote++;
+    #endif
+    /* Take back the blocks other threads have freed */
+    if (__atomic_load_n(&ar->remote, __ATOMIC_RELAXED) != NULL)
+        remote_drain(ar);
+
+    #if SLAB
+    if (asize <= SLAB_MAXSIZE)
+        return slab_alloc(ar, asize);
+    #endif
+    #if FASTBINS
+    /* A freed block of the same size, with nothing to split or mark */
+    if (FASTBIN_BIN(asize) < FASTBIN_BINS &&
+        (bp = ar->fastbin[FASTBIN_BIN(asize)]) != NULL)
+    {
+        if ((ar->fastbin[FASTBIN_BIN(asize)] = GETLP(bp)) == NULL)
+            ar->fastbinmap &= ~FASTBIT(FASTBIN_BIN(asize));
+        return bp;
+    }
+    #endif
 
     /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL) {
-	    place(bp, asize);
+    if ((bp = find_fit(ar, asize)) != NULL) {
+	    place(ar, bp, asize);
 	    return bp;
     }
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize,CHUNKSIZE);
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
+    #if FASTBINS
+    /* Coalesce the fast bins before growing the heap */
+    if (ar->fastbinmap != 0)
+    {
+        fastbin_consolidate(ar);
+        if ((bp = find_fit(ar, asize)) != NULL) {
+            place(ar, bp, asize);
+            return bp;
+        }
+    }
+    #endif
+    /*
+     * No fit found. Get more memory and place the block.  Extensions
+     * double while they follow each other closely and halve otherwise,
+     * between CHUNKSIZE and CHUNKMAX.
+     */
+    if (ar->chunk == 0)
+        ar->chunk = CHUNKSIZE;
+    else if ((ar->nmalloc - ar->lastextend) * CHUNKSIZE <
+             CHUNKWINDOW * ar->chunk)
+        ar->chunk = MIN(2 * ar->chunk, CHUNKMAX);
+    else
+        ar->chunk = MAX(ar->chunk / 2, CHUNKSIZE);
+    ar->lastextend = ar->nmalloc;
+    extendsize = MAX(asize,ar->chunk);
+    if ((bp = extend_heap(ar, extendsize/WSIZE)) == NULL)
 	    return NULL;
-    place(bp, asize);
+    place(ar, bp, asize);
     #ifdef Debug
-    if (Verbose) mm_checkheap(1);
-    else mm_checkheap(0);
+    checkop(ar, bp);
     #endif
     return bp;
 
 }
 
+/*
+ * malloc_aligned_block - allocate a block of asize bytes whose payload
+ *                        is aligned to align (a power of two above
+ *                        ALIGNMENT), ar->lock held.  The padding before and
+ *                        after the block goes back to the free lists.
+ */
+static void *malloc_aligned_block(struct arena *ar, size_t align,
+                                  size_t asize)
+{
+    char *bp, *ap;
+    size_t size, lead;
+
+    /* Room for any leading gap; never small enough for a slab */
+    size = asize + align + MINBLOCK;
+    #if SLAB
+    size = MAX(size, SLAB_MAXSIZE + ALIGNMENT);
+    #endif
+    if ((bp = malloc_block(ar, size)) == NULL)
+        return NULL;
+    size = GET_SIZE(HDRP(bp));
+    ap = (char *)(((size_t)bp + align - 1) & ~(align - 1));
+    if (ap != bp && (size_t)(ap - bp) < MINBLOCK)
+        ap += align;
+    if ((lead = ap - bp) != 0)
+    {
+        /* Free the leading padding as a block of its own */
+        PUT(HDRP(ap), PACK(size - lead, 1|PREV_ALLOC));
+        if (!ELIDE_FOOTERS)
+            PUT(FTRP(ap), PACK(size - lead, 1));
+        PUT(HDRP(bp), PACK(lead, 1|GET_PREV_ALLOC(HDRP(bp))));
+        merge_block(ar, bp);
+    }
+    trim_block(ar, ap, asize);
+    return ap;
+}
 
 /*
- * Insert free list head function
+ * trim_block - shrink the allocated block bp to asize bytes, freeing
+ *              the tail when it can hold a block, ar->lock held
  */
-static inline void insertFree(void * bp)
+static void trim_block(struct arena *ar, void *bp, size_t asize)
 {
-    int FreetableN = choosefreetable(bp);
-    freelisthead = (void *)GETLP((char*)freelisttablehead +
-                                 DSIZE * (FreetableN-1));
+    size_t size = GET_SIZE(HDRP(bp));
+    char *tp;
 
-    if(bp == freelisthead)
-    {   // do nothing, if this is already the first node of free list
+    if (size - asize < MINBLOCK)
         return;
+    PUT(HDRP(bp), PACK(asize, 1|GET_PREV_ALLOC(HDRP(bp))));
+    if (!ELIDE_FOOTERS)
+        PUT(FTRP(bp), PACK(asize, 1));
+    tp = NEXT_BLKP(bp);
+    PUT(HDRP(tp), PACK(size - asize, 1|PREV_ALLOC));
+    merge_block(ar, tp);
+}
+
+#if SLAB
+/*
+ * slab_alloc - take an object of asize bytes from a slab of arena ar,
+ *              starting a new slab if none has a free object.  ar->lock
+ *              held.
+ */
+static void *slab_alloc(struct arena *ar, size_t asize)
+{
+    struct slab **list = &ar->slabs[SLAB_CLASS(asize)];
+    struct slab *sl = *list;
+    void *bp;
+
+    if (sl == NULL)
+    {
+        /* The slab header and objects fill the payload of one block */
+        if ((sl = ar->slabcache) != NULL)
+        {
+            ar->slabcache = sl->next;
+            ar->nslabcache--;
+        }
+        else if ((sl = malloc_aligned_block(ar, SLABSIZE,
+                                            adjust_size(SLABSIZE))) != NULL)
+            PAGEMAP_AT(sl) |= SLABPAGE;
+        else
+            return NULL;
+        sl->next = sl->prev = NULL;
+        sl->freeobj = NULL;
+        sl->bump = (char *)sl + SLAB_FIRST;
+        sl->size = asize;
+        sl->nobjs = sl->nfree = (SLABSIZE - SLAB_FIRST) / asize;
+        *list = sl;
     }
-    else if (freelisthead!=NULL) //normal node of free list
+
+    if ((bp = sl->freeobj) != NULL)
+        sl->freeobj = GETLP(bp);
+    else
     {
-        PUTLP(freelisthead,bp);
-        PUTLP(((char*)bp+DSIZE),freelisthead);
-        freelisthead = bp;
-        PUTLP(freelisthead,NULL);
-        PUTLP((char*)freelisttablehead + DSIZE * (FreetableN-1),freelisthead);
+        bp = sl->bump;
+        sl->bump += asize;
     }
-    else // this is the new first node of free list
+    if (--sl->nfree == 0)
     {
-        freelisthead = bp;
-        PUTLP(freelisthead, NULL);
-        PUTLP(((char*)freelisthead+DSIZE),NULL);
-        PUTLP((char*)freelisttablehead + DSIZE * (FreetableN-1),freelisthead);
+        /* Full: off the list until an object comes back */
+        *list = sl->next;
+        if (sl->next != NULL)
+            sl->next->prev = NULL;
+        sl->next = sl->prev = NULL;
+    }
+    return bp;
+}
+
+/*
+ * slab_free - return object bp to its slab, ar->lock held.  A slab that
+ *             becomes empty goes to the slab cache, or back to the heap
+ *             once the cache is full, unless it is the last one of its
+ *             class.
+ */
+static void slab_free(struct arena *ar, void *bp)
+{
+    struct slab *sl = SLAB_OF(bp);
+    struct slab **list = &ar->slabs[SLAB_CLASS(sl->size)];
+
+    PUTLP(bp, sl->freeobj);
+    sl->freeobj = bp;
+    if (sl->nfree++ == 0)
+    {
+        sl->prev = NULL;
+        sl->next = *list;
+        if (*list != NULL)
+            (*list)->prev = sl;
+        *list = sl;
+    }
+    else if (sl->nfree == sl->nobjs && (sl->prev != NULL || sl->next != NULL))
+    {
+        if (sl->prev != NULL)
+            sl->prev->next = sl->next;
+        else
+            *list = sl->next;
+        if (sl->next != NULL)
+            sl->next->prev = sl->prev;
+        if (ar->nslabcache < SLAB_CACHE)
+        {
+            sl->next = ar->slabcache;
+            ar->slabcache = sl;
+            ar->nslabcache++;
+            return;
+        }
+        PAGEMAP_AT(sl) &= ~SLABPAGE;
+        merge_block(ar, sl);
+    }
+}
+
+/*
+ * slab_uncache - give every slab of the slab cache of arena ar back to
+ *                the heap, ar->lock held
+ */
+static void slab_uncache(struct arena *ar)
+{
+    struct slab *sl;
+
+    while ((sl = ar->slabcache) != NULL)
+    {
+        ar->slabcache = sl->next;
+        PAGEMAP_AT(sl) &= ~SLABPAGE;
+        merge_block(ar, sl);
     }
+    ar->nslabcache = 0;
+}
+#endif /* SLAB */
+
+/*
+ * adjust_size - block size needed for a payload of size bytes:
+ *               header (and footer unless ELIDE_FOOTERS) included,
+ *               rounded up to ALIGNMENT and at least MINBLOCK.  0 for a
+ *               size above MAXHEAP, which no block can hold (and which
+ *               would overflow the rounding).
+ */
+static inline size_t adjust_size(size_t size)
+{
+    size_t asize;
+
+    if (size > MAXHEAP)
+        return 0;
+    asize = ALIGN(size + OVERHEAD);
+    return MAX(asize, MINBLOCK);
+}
+
+/*
+ * set_head - make bp (NULL for none) the head of list n, and cache its
+ *            size for find_fit
+ */
+static inline void set_head(struct arena *ar, int n, void *bp)
+{
+    ar->freelist[n-1] = bp;
+    ar->headsize[n-1] = bp != NULL ? GET_SIZE(HDRP(bp)) : 0;
+}
+
+#if INSERT_POLICY != INSERT_LIFO
+/*
+ * free_before - whether free block a goes before free block b
+ */
+static inline int free_before(void *a, void *b)
+{
+    #if INSERT_POLICY == INSERT_SIZE
+    if (GET_SIZE(HDRP(a)) != GET_SIZE(HDRP(b)))
+        return GET_SIZE(HDRP(a)) < GET_SIZE(HDRP(b));
+    #endif
+    return (char *)a < (char *)b;
+}
+
+/*
+ * skip_next - the node after x (NULL-the head) on level l of list n
+ */
+static inline void *skip_next(struct arena *ar, int n, void *x, int l)
+{
+    if (l == 0)
+        return x != NULL ? NEXT_FREE(x) : ar->freelist[n-1];
+    return x != NULL ? GET_LINK(SKIP_LINKP(x, l))
+                     : ar->skip[n - SKIPLIST_FROM][l-1];
+}
+
+/*
+ * skip_link - make v the node after x (NULL-the head) on level l > 0
+ */
+static inline void skip_link(struct arena *ar, int n, void *x, int l, void *v)
+{
+    if (x != NULL)
+        PUT_LINK(SKIP_LINKP(x, l), v);
+    else
+        ar->skip[n - SKIPLIST_FROM][l-1] = v;
+}
+
+/*
+ * skip_find - the last node before bp on every level of list n
+ */
+static void skip_find(struct arena *ar, int n, void *bp, void **pred)
+{
+    void *x = NULL, *nx;
+    int l;
+
+    for (l = SKIP_LEVELS - 1; l >= 0; l--)
+    {
+        while ((nx = skip_next(ar, n, x, l)) != NULL && free_before(nx, bp))
+            x = nx;
+        pred[l] = x;
+    }
+}
+
+/*
+ * insertOrdered - insert bp in order into list n
+ */
+static void insertOrdered(struct arena *ar, int n, void *bp)
+{
+    void *pred[SKIP_LEVELS];
+    void *next;
+    unsigned int level, l;
+
+    if (n >= SKIPLIST_FROM)
+        skip_find(ar, n, bp, pred);
+    else
+    {
+        /* Short lists: walk to the place */
+        pred[0] = NULL;
+        for (next = ar->freelist[n-1]; next != NULL && free_before(next, bp);
+             next = NEXT_FREE(next))
+            pred[0] = next;
+    }
+
+    next = skip_next(ar, n, pred[0], 0);
+    SET_PREV_FREE(bp, pred[0]);
+    SET_NEXT_FREE(bp, next);
+    if (next != NULL)
+        SET_PREV_FREE(next, bp);
+    if (pred[0] != NULL)
+        SET_NEXT_FREE(pred[0], bp);
+    else
+        set_head(ar, n, bp);
+    ar->freelistbitmap |= LISTBIT(n);
+
+    if (n >= SKIPLIST_FROM)
+    {
+        /* Level L with probability 2^-L */
+        ar->seed ^= ar->seed << 13;
+        ar->seed ^= ar->seed >> 17;
+        ar->seed ^= ar->seed << 5;
+        level = 1 + __builtin_ctz(ar->seed | (1u << (SKIP_LEVELS - 1)));
+        PUT(SKIP_LEVELP(bp), level);
+        for (l = 1; l < level; l++)
+        {
+            PUT_LINK(SKIP_LINKP(bp, l), skip_next(ar, n, pred[l], l));
+            skip_link(ar, n, pred[l], l, bp);
+        }
+    }
+}
+
+/*
+ * deleteSkip - unlink bp from the levels above 0 of the skip list of
+ *              list n
+ */
+static void deleteSkip(struct arena *ar, int n, void *bp)
+{
+    void *pred[SKIP_LEVELS];
+    unsigned int level = GET(SKIP_LEVELP(bp)), l;
+
+    if (level < 2)
+        return;
+    skip_find(ar, n, bp, pred);
+    for (l = 1; l < level; l++)
+        skip_link(ar, n, pred[l], l, GET_LINK(SKIP_LINKP(bp, l)));
+}
+#endif /* INSERT_POLICY != INSERT_LIFO */
+
+#if LARGE_TREE
+/*
+ * tree_red - whether tree node bp is red (NULL leaves are black)
+ */
+static inline int tree_red(void *bp)
+{
+    return bp != NULL && GET(TREE_COLORP(bp));
+}
+
+/*
+ * tree_before - whether free block a goes before free block b in the tree
+ */
+static inline int tree_before(void *a, void *b)
+{
+    if (GET_SIZE(HDRP(a)) != GET_SIZE(HDRP(b)))
+        return GET_SIZE(HDRP(a)) < GET_SIZE(HDRP(b));
+    return (char *)a < (char *)b;
+}
+
+/*
+ * tree_replace - put node v where child u of parent p was
+ */
+static inline void tree_replace(struct arena *ar, void *p, void *u, void *v)
+{
+    if (p == NULL)
+        ar->tree = v;
+    else if (TREE_LEFT(p) == u)
+        PUT_LINK(TREE_LEFTP(p), v);
+    else
+        PUT_LINK(TREE_RIGHTP(p), v);
+    if (v != NULL)
+        PUT_LINK(TREE_PARENTP(v), p);
+}
+
+/*
+ * tree_rotate - rotate the tree left (left != 0) or right around x
+ */
+static void tree_rotate(struct arena *ar, void *x, int left)
+{
+    void *y = left ? TREE_RIGHT(x) : TREE_LEFT(x);
+    void *c = left ? TREE_LEFT(y) : TREE_RIGHT(y);
+
+    PUT_LINK(left ? TREE_RIGHTP(x) : TREE_LEFTP(x), c);
+    if (c != NULL)
+        PUT_LINK(TREE_PARENTP(c), x);
+    tree_replace(ar, TREE_PARENT(x), x, y);
+    PUT_LINK(left ? TREE_LEFTP(y) : TREE_RIGHTP(y), x);
+    PUT_LINK(TREE_PARENTP(x), y);
+}
+
+/*
+ * insertTree - insert bp into the tree and, in the same order, into the
+ *              last list
+ */
+static void insertTree(struct arena *ar, void *bp)
+{
+    void *p = NULL, *x = ar->tree, *pred = NULL, *next;
+    void *g, *u;
+    int left = 0;
+
+    while (x != NULL)
+    {
+        p = x;
+        if ((left = tree_before(bp, x)))
+            x = TREE_LEFT(x);
+        else
+        {
+            pred = x;
+            x = TREE_RIGHT(x);
+        }
+    }
+    PUT_LINK(TREE_LEFTP(bp), NULL);
+    PUT_LINK(TREE_RIGHTP(bp), NULL);
+    PUT_LINK(TREE_PARENTP(bp), p);
+    PUT(TREE_COLORP(bp), 1);
+    if (p == NULL)
+        ar->tree = bp;
+    else
+        PUT_LINK(left ? TREE_LEFTP(p) : TREE_RIGHTP(p), bp);
+
+    /* The list is the in-order walk: link bp after its predecessor */
+    next = pred != NULL ? NEXT_FREE(pred) : ar->freelist[MAXFREESIZE-1];
+    SET_PREV_FREE(bp, pred);
+    SET_NEXT_FREE(bp, next);
+    if (next != NULL)
+        SET_PREV_FREE(next, bp);
+    if (pred != NULL)
+        SET_NEXT_FREE(pred, bp);
+    else
+        set_head(ar, MAXFREESIZE, bp);
+    ar->freelistbitmap |= LISTBIT(MAXFREESIZE);
+
+    /* Restore the red-black properties */
+    x = bp;
+    while (tree_red(p = TREE_PARENT(x)))
+    {
+        g = TREE_PARENT(p);
+        left = (p == TREE_LEFT(g));
+        u = left ? TREE_RIGHT(g) : TREE_LEFT(g);
+        if (tree_red(u))
+        {
+            PUT(TREE_COLORP(p), 0);
+            PUT(TREE_COLORP(u), 0);
+            PUT(TREE_COLORP(g), 1);
+            x = g;
+            continue;
+        }
+        if (x == (left ? TREE_RIGHT(p) : TREE_LEFT(p)))
+        {
+            tree_rotate(ar, p, left);
+            x = p;
+            p = TREE_PARENT(x);
+        }
+        PUT(TREE_COLORP(p), 0);
+        PUT(TREE_COLORP(g), 1);
+        tree_rotate(ar, g, !left);
+    }
+    PUT(TREE_COLORP(ar->tree), 0);
+}
+
+/*
+ * deleteTree - remove bp from the tree (not from the last list)
+ */
+static void deleteTree(struct arena *ar, void *bp)
+{
+    void *x, *p, *y, *w;
+    int black = !tree_red(bp), left;
+
+    if (TREE_LEFT(bp) == NULL || TREE_RIGHT(bp) == NULL)
+    {
+        x = TREE_LEFT(bp) != NULL ? TREE_LEFT(bp) : TREE_RIGHT(bp);
+        p = TREE_PARENT(bp);
+        tree_replace(ar, p, bp, x);
+    }
+    else
+    {
+        /* Move up the successor, the next block on the list */
+        y = NEXT_FREE(bp);
+        black = !tree_red(y);
+        x = TREE_RIGHT(y);
+        if (TREE_PARENT(y) == bp)
+            p = y;
+        else
+        {
+            p = TREE_PARENT(y);
+            tree_replace(ar, p, y, x);
+            PUT_LINK(TREE_RIGHTP(y), TREE_RIGHT(bp));
+            PUT_LINK(TREE_PARENTP(TREE_RIGHT(y)), y);
+        }
+        tree_replace(ar, TREE_PARENT(bp), bp, y);
+        PUT_LINK(TREE_LEFTP(y), TREE_LEFT(bp));
+        PUT_LINK(TREE_PARENTP(TREE_LEFT(y)), y);
+        PUT(TREE_COLORP(y), GET(TREE_COLORP(bp)));
+    }
+    if (!black)
+        return;
+
+    /* x (maybe NULL) under p carries an extra black: push it up */
+    while (x != ar->tree && !tree_red(x))
+    {
+        left = (x == TREE_LEFT(p));
+        w = left ? TREE_RIGHT(p) : TREE_LEFT(p);
+        if (tree_red(w))
+        {
+            PUT(TREE_COLORP(w), 0);
+            PUT(TREE_COLORP(p), 1);
+            tree_rotate(ar, p, left);
+            w = left ? TREE_RIGHT(p) : TREE_LEFT(p);
+        }
+        if (!tree_red(TREE_LEFT(w)) && !tree_red(TREE_RIGHT(w)))
+        {
+            PUT(TREE_COLORP(w), 1);
+            x = p;
+            p = TREE_PARENT(x);
+            continue;
+        }
+        if (!tree_red(left ? TREE_RIGHT(w) : TREE_LEFT(w)))
+        {
+            PUT(TREE_COLORP(left ? TREE_LEFT(w) : TREE_RIGHT(w)), 0);
+            PUT(TREE_COLORP(w), 1);
+            tree_rotate(ar, w, !left);
+            w = left ? TREE_RIGHT(p) : TREE_LEFT(p);
+        }
+        PUT(TREE_COLORP(w), GET(TREE_COLORP(p)));
+        PUT(TREE_COLORP(p), 0);
+        PUT(TREE_COLORP(left ? TREE_RIGHT(w) : TREE_LEFT(w)), 0);
+        tree_rotate(ar, p, left);
+        x = ar->tree;
+    }
+    if (x != NULL)
+        PUT(TREE_COLORP(x), 0);
+}
+
+/*
+ * tree_fit - the smallest block of the tree holding asize bytes
+ */
+static void *tree_fit(struct arena *ar, size_t asize)
+{
+    void *x = ar->tree, *best = NULL;
+
+    while (x != NULL)
+    {
+        ar->stats.nprobe++;
+        if (GET_SIZE(HDRP(x)) >= asize)
+        {
+            best = x;
+            x = TREE_LEFT(x);
+        }
+        else
+            x = TREE_RIGHT(x);
+    }
+    return best;
+}
+#endif /* LARGE_TREE */
+
+/*
+ * Insert free list head function
+ */
+static inline void insertFree(struct arena *ar, void * bp)
+{
+    int FreetableN = choosefreetable(bp);
+    void *freelisthead = ar->freelist[FreetableN-1];
+
+    #ifdef Debug
+    ar->touched |= LISTBIT(FreetableN);
+    #endif
+    #if LARGE_TREE
+    if (FreetableN == MAXFREESIZE)
+    {
+        insertTree(ar, bp);
+        return;
+    }
+    #endif
+    #if INSERT_POLICY != INSERT_LIFO
+    if (FreetableN >= INSERT_FROM)
+    {
+        insertOrdered(ar, FreetableN, bp);
+        return;
+    }
+    #endif
+
+    if(bp == freelisthead)
+    {   // do nothing, if this is already the first node of free list
+        return;
+    }
+    else if (freelisthead!=NULL) //normal node of free list
+    {
+        SET_PREV_FREE(freelisthead,bp);
+        SET_NEXT_FREE(bp,freelisthead);
+        freelisthead = bp;
+        SET_PREV_FREE(freelisthead,NULL);
+        set_head(ar, FreetableN, freelisthead);
+    }
+    else // this is the new first node of free list
+    {
+        freelisthead = bp;
+        SET_PREV_FREE(freelisthead, NULL);
+        SET_NEXT_FREE(freelisthead, NULL);
+        set_head(ar, FreetableN, freelisthead);
+        ar->freelistbitmap |= LISTBIT(FreetableN);
+    }
+}
+
+/*
+ *  choosefreetable:
+ *  Choose the most appropriate table number
+ *  based on the block pointer as argument
+ */
+
+static inline int choosefreetable(void * bp)
+{
+    return choosefreetable_bysize(GET_SIZE(HDRP(bp)));
+
+}
+
+/*
+ *  choosefreetable_bysize:
+ *  Choose the most appropriate table number
+ *  based on the block size as argument, in constant time:
+ *  a table lookup for the small lists, a bit scan for the rest.
+ */
+static inline int choosefreetable_bysize(size_t freeblksize)
+{
+    size_t temp = freeblksize/DSIZE;
+    if (temp <= SMALLCLASS_MAX)
+        return sizeclass_table[temp];
+    if (temp > LIST17)
+        return MAXFREESIZE;
+    return SIZECLASS_OF(SMALLCLASS_MAX) + CEIL_LOG2(temp) - SMALLCLASS_LOG2;
+}
+
+/*
+ * deleteFree:
+ * Delete one node from the free list
+ * and link the pre to next.
+ */
+
+static inline void deleteFree(struct arena *ar, void *bp)
+{
+    void * pre_f;
+    void * next_f;
+    int FreetableN = choosefreetable(bp);
+
+    #ifdef Debug
+    ar->touched |= LISTBIT(FreetableN);
+    #endif
+    #if LARGE_TREE
+    if (FreetableN == MAXFREESIZE)
+        deleteTree(ar, bp);
+    #endif
+    #if INSERT_POLICY != INSERT_LIFO
+    if (FreetableN >= SKIPLIST_FROM && FreetableN >= INSERT_FROM &&
+        FreetableN < MAXFREESIZE + !LARGE_TREE)
+        deleteSkip(ar, FreetableN, bp);
+    #endif
+
+    pre_f = PREV_FREE(bp);
+    next_f= NEXT_FREE(bp);
+    if (pre_f!=NULL)
+    {
+        SET_NEXT_FREE(pre_f,next_f);
+    }
+    else
+    {
+        set_head(ar, FreetableN, next_f);
+        if (next_f == NULL) // the list is empty now
+            ar->freelistbitmap &= ~LISTBIT(FreetableN);
+    }
+    if (next_f!=NULL) SET_PREV_FREE(next_f,pre_f);
+}
+
+
+/*
+ * free---To free a block with necessary inserting & coalescing action
+ *        Small blocks go to the thread cache instead.
+ */
+void free (void *ptr) {
+
+	if (ptr != NULL)
+	{
+	    profile_free(ptr);
+	    #if MMAP_LARGE
+	    if (is_mmapped(ptr))
+	    {
+	        munmap_block(ptr);
+	        return;
+	    }
+	    #endif
+	    #if TCACHE
+	    size_t fsize = block_size(ptr);
+	    if (fsize <= TCACHE_MAXSIZE)
+	    {
+	        tcache_put(ptr, fsize);
+	        return;
+	    }
+	    #endif
+	    arena_free(ptr);
+    	}
+    else
+    {
+        return;
+    }
+}
+
+/*
+ * mm_free_sized - free ptr, allocated with size bytes, without reading
+ *                 its header when the size is one of the thread cache.
+ *                 Any size from the one asked for to mm_usable_size(ptr)
+ *                 will do.  The size cannot tell a mapped block, which
+ *                 realloc may shrink below MMAP_THRESHOLD, so any block
+ *                 outside the heap goes to free.
+ */
+void mm_free_sized(void *ptr, size_t size)
+{
+    size_t asize;
+
+    if (ptr == NULL)
+        return;
+    /* No block is that large: the size is wrong, so read the header */
+    if ((asize = adjust_size(size)) == 0)
+    {
+        free(ptr);
+        return;
+    }
+    #ifdef Debug
+    checksize(ptr, asize);
+    #endif
+    #if MMAP_LARGE
+    if (!in_heap(ptr))
+    {
+        free(ptr);
+        return;
+    }
+    #endif
+    profile_free(ptr);
+    #if TCACHE
+    if (asize <= TCACHE_MAXSIZE)
+    {
+        tcache_put(ptr, asize);
+        return;
+    }
+    #endif
+    arena_free(ptr);
+}
+
+/*
+ * mm_usable_size - bytes of ptr the caller may use, at least the size it
+ *                  was allocated with.  A slab object has no header, but
+ *                  its OVERHEAD bytes are not counted either: the usable
+ *                  size of every heap block then adjusts back to its
+ *                  block size, so mm_free_sized and realloc take it as
+ *                  the size of the block.  A mapped block can use all of
+ *                  its pages.  0 for NULL.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (ptr == NULL)
+        return 0;
+    return block_size(ptr) - OVERHEAD;
+}
+
+/*
+ * mm_malloc_sized_result - malloc size bytes, and return the block with
+ *                          its usable size, so a container can use all
+ *                          of it.  {NULL, 0} if out of memory.
+ */
+struct mm_sized_result mm_malloc_sized_result(size_t size)
+{
+    struct mm_sized_result result;
+
+    result.ptr = malloc(size);
+    result.size = mm_usable_size(result.ptr);
+    return result;
+}
+
+/*
+ * arena_free - free block bp into the arena owning it.  A block of
+ *              another thread's arena goes to that arena's remote free
+ *              queue instead, so the caller never waits for its lock.
+ */
+static void arena_free(void *bp)
+{
+    struct arena *ar = arena_of(bp);
+    #if REMOTE_FREE && NARENAS > 1
+    void *head;
+
+    if (ar != arena_choose())
+    {
+        /* Many producers push, only the arena lock holder pops */
+        head = __atomic_load_n(&ar->remote, __ATOMIC_RELAXED);
+        do
+            PUTLP(bp, head);
+        while (!__atomic_compare_exchange_n(&ar->remote, &head, bp, 1,
+                                            __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED));
+        return;
+    }
+    #endif
+
+    pthread_mutex_lock(&ar->lock);
+    free_block(ar, bp);
+    pthread_mutex_unlock(&ar->lock);
+}
+
+/*
+ * remote_drain - free every block on the remote free queue of arena ar,
+ *                ar->lock held.  The whole queue is detached at once, so
+ *                pushes racing with the drain simply start a new one.
+ */
+static void remote_drain(struct arena *ar)
+{
+    void *bp = __atomic_exchange_n(&ar->remote, NULL, __ATOMIC_ACQUIRE);
+    void *next;
+
+    while (bp != NULL)
+    {
+        next = GETLP(bp);
+        free_block(ar, bp);
+        bp = next;
+    }
+}
+
+/*
+ * free_block - free an allocated block into a fast bin or the free
+ *              lists, or return a slab object to its slab, ar->lock held
+ */
+static void free_block(struct arena *ar, void *ptr)
+{
+	    #if SLAB
+	    if (is_slab(ptr))
+	    {
+	        ar->stats.nfree[choosefreetable_bysize(SLAB_OF(ptr)->size)-1]++;
+	        slab_free(ar, ptr);
+	        return;
+	    }
+	    #endif
+	    ar->stats.nfree[choosefreetable(ptr) - 1]++;
+	    #if FASTBINS
+	    size_t b = FASTBIN_BIN(GET_SIZE(HDRP(ptr)));
+	    if (b < FASTBIN_BINS)
+	    {
+	        PUTLP(ptr, ar->fastbin[b]);
+	        ar->fastbin[b] = ptr;
+	        ar->fastbinmap |= FASTBIT(b);
+	        return;
+	    }
+	    #endif
+	    merge_block(ar, ptr);
+}
+
+/*
+ * merge_block - mark an allocated block free and coalesce it,
+ *               ar->lock held
+ */
+static void merge_block(struct arena *ar, void *ptr)
+{
+	    size_t fsize = GET_SIZE(HDRP(ptr));
+
+	    __atomic_sub_fetch(&live_stats.live, fsize, __ATOMIC_RELAXED);
+	    PUT(HDRP(ptr), PACK(fsize,GET_PREV_ALLOC(HDRP(ptr))));
+            PUT(FTRP(ptr), GET(HDRP(ptr)));
+            CLR_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
+            ptr = coalesce(ar, ptr);
+            #ifdef Debug
+            checkop(ar, ptr);
+            #endif
+}
+
+/*
+ * live_add - count size more bytes of allocated heap blocks.  All arenas
+ *            add to one count, so its peak is the peak of the heap.
+ */
+static void live_add(size_t size)
+{
+    size_t now = __atomic_add_fetch(&live_stats.live, size,
+                                    __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&live_stats.peak, __ATOMIC_RELAXED);
+
+    while (now > peak &&
+           !__atomic_compare_exchange_n(&live_stats.peak, &peak, now,
+                                        1, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+        ;
+}
+
+#if FASTBINS
+/*
+ * fastbin_consolidate - coalesce every block of the fast bins of arena
+ *                       ar into the free lists, ar->lock held
+ */
+static void fastbin_consolidate(struct arena *ar)
+{
+    uint64_t map = ar->fastbinmap;
+    void *bp;
+    int b;
+
+    while (map != 0)
+    {
+        b = __builtin_ctzll(map);
+        map &= map - 1;
+        while ((bp = ar->fastbin[b]) != NULL)
+        {
+            if ((ar->fastbin[b] = GETLP(bp)) == NULL)
+                ar->fastbinmap &= ~FASTBIT(b);
+            merge_block(ar, bp);
+        }
+    }
+}
+#endif
+
+/*
+ * mm_consolidate - coalesce the fast bins of every arena, including the
+ *                  blocks waiting on its remote free queue
+ */
+void mm_consolidate(void)
+{
+    int i;
+
+    if (arenas == NULL)
+        return;
+    for (i = 0; i < NARENAS; i++)
+    {
+        pthread_mutex_lock(&arenas[i].lock);
+        remote_drain(&arenas[i]);
+        #if FASTBINS
+        fastbin_consolidate(&arenas[i]);
+        #endif
+        pthread_mutex_unlock(&arenas[i].lock);
+    }
+}
+
+#if TCACHE
+/*
+ * tcache_key_init - create the key whose destructor flushes a thread's
+ *                   cache when the thread exits
+ */
+static void tcache_destroy(void *arg);
+static void tcache_key_init(void)
+{
+    pthread_key_create(&tcache_key, tcache_destroy);
+}
+
+/*
+ * tcache_self - the calling thread's cache, carved from arena ar if the
+ *               thread has none yet or mm_init has reset the heap since.
+ *               ar->lock held; returns NULL if the heap is full.
+ */
+static struct tcache *tcache_self(struct arena *ar)
+{
+    struct tcache *tc = tcache;
+
+    if (tc != NULL && tc->gen == heap_gen)
+        return tc;
+    /* Blocks cached before a reset belong to the old heap: drop them */
+    tc = malloc_block(ar, adjust_size(sizeof(struct tcache)));
+    if (tc == NULL)
+        return NULL;
+    memset(tc, 0, sizeof(struct tcache));
+    tc->gen = heap_gen;
+    pthread_once(&tcache_once, tcache_key_init);
+    pthread_setspecific(tcache_key, tc);
+    tcache = tc;
+    return tc;
+}
+
+/*
+ * tcache_get - pop a block of asize bytes from the thread cache, or
+ *              refill the bin with a batch of blocks from the heap.
+ */
+static void *tcache_get(size_t asize)
+{
+    struct tcache *tc = tcache;
+    size_t b = TCACHE_BIN(asize);
+    size_t i, n;
+    void *bp, *cp;
+    struct arena *ar;
+
+    if (tc != NULL && tc->gen == heap_gen && (bp = tc->bin[b]) != NULL)
+    {
+        tc->bin[b] = GETLP(bp);
+        tc->count[b]--;
+        tc->hits++;
+        tc->nmalloc[choosefreetable_bysize(asize) - 1]++;
+        return bp;
+    }
+
+    /* Bin is empty: move up to one batch from the arena at once */
+    if ((ar = arena_choose()) == NULL)
+        return NULL;
+    pthread_mutex_lock(&ar->lock);
+    bp = malloc_block(ar, asize);
+    if (bp != NULL && (tc = tcache_self(ar)) != NULL)
+    {
+        n = MIN(TCACHE_BATCH, TCACHE_REFILL_BYTES / asize);
+        for (i = 1; i < n; i++)
+        {
+            if ((cp = malloc_block(ar, asize)) == NULL)
+                break;
+            PUTLP(cp, tc->bin[b]);
+            tc->bin[b] = cp;
+            tc->count[b]++;
+        }
+        /* Cached blocks count when they leave the cache */
+        ar->stats.nmalloc[choosefreetable_bysize(asize) - 1] -= i - 1;
+        tcache_stats(tc, ar);
+    }
+    pthread_mutex_unlock(&ar->lock);
+    return bp;
+}
+
+/*
+ * tcache_put - push a block of size bytes into the thread cache.  A full
+ *              bin is flushed down to half: blocks of the thread's arena
+ *              under one lock acquisition, the others through arena_free.
+ */
+static void tcache_put(void *bp, size_t size)
+{
+    struct tcache *tc = tcache;
+    size_t b = TCACHE_BIN(size);
+    struct arena *ar;
+    void *fp, *foreign = NULL;
+
+    if (tc != NULL && tc->gen == heap_gen && tc->count[b] < TCACHE_FILL)
+    {
+        PUTLP(bp, tc->bin[b]);
+        tc->bin[b] = bp;
+        tc->count[b]++;
+        tc->puts++;
+        tc->nfree[choosefreetable_bysize(size) - 1]++;
+        return;
+    }
+
+    ar = arena_choose();
+    pthread_mutex_lock(&ar->lock);
+    PUTLP(bp, NULL);
+    if ((tc = tcache_self(ar)) != NULL)
+    {
+        tcache_stats(tc, ar);
+        while (tc->count[b] > TCACHE_FILL / 2)
+        {
+            fp = tc->bin[b];
+            tc->bin[b] = GETLP(fp);
+            tc->count[b]--;
+            PUTLP(fp, bp);
+            bp = fp;
+            /* Counted when put, and again by free_block */
+            ar->stats.nfree[choosefreetable_bysize(size) - 1]--;
+        }
+    }
+    while ((fp = bp) != NULL)
+    {
+        bp = GETLP(fp);
+        if (arena_of(fp) == ar)
+            free_block(ar, fp);
+        else
+        {
+            PUTLP(fp, foreign);
+            foreign = fp;
+        }
+    }
+    pthread_mutex_unlock(&ar->lock);
+
+    while ((fp = foreign) != NULL)
+    {
+        foreign = GETLP(fp);
+        arena_free(fp);
+    }
+}
+
+/*
+ * tcache_stats - move the per-list counts of cache tc into the stats of
+ *                arena ar, ar->lock held
+ */
+static void tcache_stats(struct tcache *tc, struct arena *ar)
+{
+    int n;
+
+    for (n = 0; n < MAXFREESIZE; n++)
+    {
+        ar->stats.nmalloc[n] += tc->nmalloc[n];
+        ar->stats.nfree[n] += tc->nfree[n];
+        tc->nmalloc[n] = tc->nfree[n] = 0;
+    }
+}
+
+/*
+ * tcache_destroy - return every cached block and the cache itself
+ */
+static void tcache_destroy(void *arg)
+{
+    struct tcache *tc = arg;
+    struct arena *ar;
+    size_t b;
+    void *bp;
+
+    if (tc->gen == heap_gen)
+    {
+        for (b = 0; b < TCACHE_BINS; b++)
+        {
+            while ((bp = tc->bin[b]) != NULL)
+            {
+                tc->bin[b] = GETLP(bp);
+                /* Counted when put or left uncounted, not freed again */
+                tc->nfree[choosefreetable_bysize(
+                    b * ALIGNMENT + MINBLOCK) - 1]--;
+                arena_free(bp);
+            }
+        }
+        if ((ar = arena_choose()) != NULL)
+        {
+            pthread_mutex_lock(&ar->lock);
+            tcache_stats(tc, ar);
+            pthread_mutex_unlock(&ar->lock);
+        }
+        arena_free(tc);
+    }
+    tcache = NULL;
+}
+#endif /* TCACHE */
+
+
+
+/*
+ * realloc - you may want to look at mm-naive.c
+ *           A block shrinks or grows in place when it can, so only
+ *           a growth with no room behind the block copies the data.
+ */
+void *realloc(void *oldptr, size_t size)
+{
+    size_t oldsize, asize;
+    struct arena *ar;
+    void *newptr;
+    int done, mapped, slab;
+
+    /* If size == 0 then this is just free, and we return NULL. */
+    if(size == 0)
+    {
+        free(oldptr);
+        return 0;
+    }
+
+    /* If oldptr is NULL, then this is just malloc. */
+    if(oldptr == NULL)
+    {
+        return malloc(size);
+    }
+
+    /* No block is that large: fail, leaving the old block untouched */
+    if ((asize = adjust_size(size)) == 0)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    oldsize = block_size(oldptr);
+    mapped = is_mmapped(oldptr);
+    slab = !mapped && is_slab(oldptr);
+    #if MMAP_LARGE
+    if (mapped && asize >= MMAP_THRESHOLD)
+        return profile_resize(oldptr, mremap_block(oldptr, size), size);
+    #endif
+
+    if (asize <= oldsize && (oldsize - asize < REALLOC_SHRINK || slab))
+    {
+        return profile_resize(oldptr, oldptr, size);
+    }
+    if (!slab && !mapped)
+    {
+        ar = arena_of(oldptr);
+        pthread_mutex_lock(&ar->lock);
+        done = resize_block(ar, oldptr, asize);
+        pthread_mutex_unlock(&ar->lock);
+        if (done)
+            return profile_resize(oldptr, oldptr, size);
+    }
+
+    newptr = malloc(size);
+    /* If realloc() fails the original block is left untouched  */
+    if(!newptr)
+    {
+        return 0;
+    }
+    /* Copy the old data. */
+    memcpy(newptr, oldptr, MIN(size, slab ? oldsize : oldsize - OVERHEAD));
+    /* Free the old block. */
+    free(oldptr);
+    return newptr;
+}
+
+/*
+ * resize_block - resize the allocated block bp to asize bytes without
+ *                moving it, ar->lock held.  A block grows into the free
+ *                block after it, extending the arena first when the block
+ *                is at its top.  Returns 1 on success, 0 if bp must move.
+ */
+static int resize_block(struct arena *ar, void *bp, size_t asize)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *next = NEXT_BLKP(bp);
+    size_t room = size;
+
+    if (asize > size)
+    {
+        if (!GET_ALLOC(HDRP(next)))
+        {
+            room += GET_SIZE(HDRP(next));
+            next = NEXT_BLKP(next);
+        }
+        if (room < asize)
+        {
+            /* Only the shortfall is needed if the arena ends the heap */
+            if (next != ar->top ||
+                ar->top != __atomic_load_n(&heap_end, __ATOMIC_RELAXED))
+                return 0;
+            if (extend_heap(ar, (asize - room + WSIZE - 1) / WSIZE) == NULL)
+                return 0;
+            /* Another arena may have taken the end of the heap meanwhile */
+            next = NEXT_BLKP(bp);
+            if (GET_ALLOC(HDRP(next)) || size + GET_SIZE(HDRP(next)) < asize)
+                return 0;
+        }
+        /* Absorb the next block */
+        next = NEXT_BLKP(bp);
+        deleteFree(ar, next);
+        size += GET_SIZE(HDRP(next));
+        live_add(GET_SIZE(HDRP(next)));
+        PUT(HDRP(bp), PACK(size, 1|GET_PREV_ALLOC(HDRP(bp))));
+        if (!ELIDE_FOOTERS)
+            PUT(FTRP(bp), PACK(size, 1));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    }
+    #if HEAP_TRIM
+    if ((char *)bp + asize + FREEHEAD > ar->trimmed)
+        ar->trimmed = (char *)PAGE_ALIGN((char *)bp + asize + FREEHEAD);
+    #endif
+    ar->clean = MAX(ar->clean, (char *)bp + asize + FREEHEAD);
+    trim_block(ar, bp, asize);
+    return 1;
+}
+
+#if MMAP_LARGE
+/*
+ * mmap_block - map a block of its own with a payload of size bytes.
+ *              NULL, with errno ENOMEM, if it cannot.
+ */
+static void *mmap_block(size_t size)
+{
+    return mmap_aligned_block(ALIGNMENT, size);
+}
+
+/*
+ * mmap_aligned_block - map a block of its own with a payload of size
+ *                      bytes aligned to align, a power of two.  The
+ *                      mapping has room for any gap before the payload;
+ *                      its whole pages on either side of the block are
+ *                      unmapped again.  NULL, with errno ENOMEM, if it
+ *                      cannot.
+ */
+static void *mmap_aligned_block(size_t align, size_t size)
+{
+    size_t len;
+    char *mp, *bp, *lo, *hi;
+
+    /* The header holds the size in 32 bits */
+    if (size > (size_t)UINT32_MAX - 2*PAGESIZE || align > MAXHEAP / 2)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    len = PAGE_ALIGN(size + MAX(align, MMAP_OVERHEAD));
+    mp = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+              -1, 0);
+    if (mp == MAP_FAILED)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    bp = (char *)(((size_t)mp + MMAP_OVERHEAD + align - 1) & ~(align - 1));
+    lo = (char *)PAGE_DOWN(bp - MMAP_OVERHEAD);
+    hi = (char *)PAGE_ALIGN(bp + size);
+    if (lo > mp)
+        munmap(mp, lo - mp);
+    if (hi < mp + len)
+        munmap(hi, mp + len - hi);
+    PUT(bp - DSIZE, bp - lo);
+    PUT(HDRP(bp), PACK(hi - bp, 1|MMAPPED));
+    __atomic_fetch_add(&map_stats.nmmap, 1, __ATOMIC_RELAXED);
+    mapped_add(hi - lo);
+    return bp;
+}
+
+/*
+ * mapped_add - count size more bytes of mapped blocks
+ */
+static void mapped_add(size_t size)
+{
+    size_t now = __atomic_add_fetch(&map_stats.mapped, size,
+                                    __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&map_stats.mapped_peak, __ATOMIC_RELAXED);
+
+    while (now > peak &&
+           !__atomic_compare_exchange_n(&map_stats.mapped_peak, &peak, now,
+                                        1, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+        ;
+}
+
+/*
+ * mremap_block - resize the mapped block bp to a payload of size bytes,
+ *                moving it if the mapping cannot grow in place (which
+ *                keeps its alignment only up to a page).  NULL,
+ *                with errno ENOMEM and bp left as it was, if it cannot.
+ */
+static void *mremap_block(void *bp, size_t size)
+{
+    size_t offset = MMAP_OFFSET(bp);
+    size_t oldlen = MMAP_LEN(bp);
+    size_t len = PAGE_ALIGN(size + offset);
+    char *mp = (char *)bp - offset;
+
+    #ifdef Debug
+    checkmapped(bp);
+    #endif
+    if (len == oldlen)
+        return bp;
+    if (size > (size_t)UINT32_MAX - 2*PAGESIZE)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    mp = mremap(mp, oldlen, len, MREMAP_MAYMOVE);
+    if (mp == MAP_FAILED)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (len > oldlen)
+        mapped_add(len - oldlen);
+    else
+        __atomic_sub_fetch(&map_stats.mapped, oldlen - len, __ATOMIC_RELAXED);
+    PUT(mp + offset - WSIZE, PACK(len - offset, 1|MMAPPED));
+    return mp + offset;
+}
+
+/*
+ * munmap_block - give the mapping of block bp back to the OS
+ */
+static void munmap_block(void *bp)
+{
+    size_t len = MMAP_LEN(bp);
+
+    #ifdef Debug
+    checkmapped(bp);
+    #endif
+    __atomic_fetch_add(&map_stats.nmunmap, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&map_stats.mapped, len, __ATOMIC_RELAXED);
+    munmap((char *)bp - MMAP_OFFSET(bp), len);
+}
+#endif /* MMAP_LARGE */
+
+/*
+ * calloc - you may want to look at mm-naive.c
+ * This function is not tested by mdriver, but it is
+ * needed to run the traces.
+ * Mapped blocks are zero already, and so is a block place just cut from
+ * the clean heap, past its old links.
+ */
+void *calloc (size_t nmemb, size_t size) {
+    size_t bytes, asize;
+    void *newptr;
+
+    if (__builtin_mul_overflow(nmemb, size, &bytes) || bytes > MAXHEAP)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    asize = adjust_size(bytes);
+    #if MMAP_LARGE
+    if (asize >= MMAP_THRESHOLD)
+        return profile_alloc(mmap_block(bytes), bytes);
+    #endif
+
+    newptr = malloc(bytes);
+    if (newptr == NULL)
+        return NULL;
+    /* Smaller blocks may come from a cache, with a stale header */
+    if (asize > MAX(TCACHE_MAXSIZE, FASTBIN_MAXSIZE) &&
+        (GET_SHARED(HDRP(newptr)) & ZEROED))
+        bytes = MIN(bytes, FREEHEAD);
+    memset(newptr, 0, bytes);
+
+    return newptr;
+}
+
+/*
+ * mm_memalign - allocate size bytes aligned to alignment, a power of
+ *               two.  The block is an ordinary block, cut from a fit with
+ *               room for the leading gap, or mapped on its own from
+ *               MMAP_THRESHOLD bytes as by malloc, so free and realloc
+ *               take it as it is.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    size_t asize;
+    struct arena *ar;
+    void *bp;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (alignment <= ALIGNMENT)
+        return malloc(size);
+    if (size == 0)
+        return NULL;
+    /* The block cut for the leading gap must fit in a header too */
+    if ((asize = adjust_size(size)) == 0 || alignment > MAXHEAP / 2 ||
+        asize + alignment + MINBLOCK >= MAXHEAP)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    #if MMAP_LARGE
+    if (asize >= MMAP_THRESHOLD)
+        return profile_alloc(mmap_aligned_block(alignment, size), size);
+    #endif
+    if ((ar = arena_choose()) == NULL)
+        return NULL;
+    pthread_mutex_lock(&ar->lock);
+    bp = malloc_aligned_block(ar, alignment, asize);
+    pthread_mutex_unlock(&ar->lock);
+    return profile_alloc(bp, size);
+}
+
+/*
+ * mm_aligned_alloc - C11 aligned_alloc
+ */
+void *mm_aligned_alloc(size_t alignment, size_t size)
+{
+    return mm_memalign(alignment, size);
+}
+
+/*
+ * mm_posix_memalign - POSIX posix_memalign: 0 on success, EINVAL if
+ *                     alignment is not a power of two multiple of
+ *                     sizeof(void *), ENOMEM if memory ran out
+ */
+int mm_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *bp;
+
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    if ((bp = mm_memalign(alignment, size)) == NULL && size != 0)
+        return ENOMEM;
+    *memptr = bp;
+    return 0;
+}
+
+/*
+ * mm_malloc_batch - allocate n blocks of size bytes each into ptrs.
+ *                   Returns the number allocated, less than n only when
+ *                   the memory runs out.
+ */
+size_t mm_malloc_batch(size_t size, void **ptrs, size_t n)
+{
+    size_t done = malloc_batch(size, ptrs, n), i;
+
+    /* Sampling takes a backtrace, so not under the arena lock */
+    for (i = 0; i < done; i++)
+        profile_alloc(ptrs[i], size);
+    return done;
+}
+
+/*
+ * malloc_batch - mm_malloc_batch.  Heap blocks are cut from one block of
+ *                up to BATCH_BYTES at a time, found or made by a single
+ *                malloc_block.
+ */
+static size_t malloc_batch(size_t size, void **ptrs, size_t n)
+{
+    size_t asize, bsize, csize, done = 0, i, k;
+    struct arena *ar;
+    char *bp;
+
+    if (size == 0 || n == 0)
+        return 0;
+    if ((asize = adjust_size(size)) == 0)
+    {
+        errno = ENOMEM;
+        return 0;
+    }
+    #if MMAP_LARGE
+    if (asize >= MMAP_THRESHOLD)
+    {
+        while (done < n && (ptrs[done] = mmap_block(size)) != NULL)
+            done++;
+        return done;
+    }
+    #endif
+
+    if ((ar = arena_choose()) == NULL)
+        return 0;
+    pthread_mutex_lock(&ar->lock);
+    #if SLAB
+    if (asize <= SLAB_MAXSIZE)
+    {
+        /* Slab objects have no header to cut: take them one by one */
+        while (done < n && (ptrs[done] = malloc_block(ar, asize)) != NULL)
+            done++;
+        pthread_mutex_unlock(&ar->lock);
+        return done;
+    }
+    #endif
+    while (done < n)
+    {
+        k = MIN(n - done, MAX(BATCH_BYTES / asize, 1));
+        if ((bp = malloc_block(ar, k * asize)) == NULL)
+            break;
+        ar->nmalloc += k - 1;
+        ar->stats.nmalloc[choosefreetable_bysize(k * asize) - 1]--;
+        ar->stats.nmalloc[choosefreetable_bysize(asize) - 1] += k;
+        /* Cut the block into k blocks, the last one keeping any slack */
+        bsize = GET_SIZE(HDRP(bp));
+        for (i = 0; i < k; i++, bp += asize)
+        {
+            csize = i + 1 < k ? asize : bsize - (k - 1) * asize;
+            PUT(HDRP(bp), PACK(csize,
+                            1|(i ? PREV_ALLOC : GET_PREV_ALLOC(HDRP(bp)))));
+            if (!ELIDE_FOOTERS)
+                PUT(FTRP(bp), PACK(csize, 1));
+            ptrs[done++] = bp;
+        }
+    }
+    pthread_mutex_unlock(&ar->lock);
+    return done;
+}
+
+/*
+ * ptr_compare - qsort order of pointers by address
+ */
+static int ptr_compare(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(void * const *)a;
+    uintptr_t y = (uintptr_t)*(void * const *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * mm_free_batch - free the n blocks of ptrs, skipping NULLs, and leave
+ *                 ptrs sorted by address.  A run of blocks next to each
+ *                 other in the heap is joined and coalesced as one block,
+ *                 and an arena lock is only taken again when the arena
+ *                 changes.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    struct arena *ar = NULL, *owner;
+    size_t i, size;
+    char *bp;
+
+    for (i = 0; i < n; i++)
+        if (ptrs[i] != NULL)
+            profile_free(ptrs[i]);
+    qsort(ptrs, n, sizeof(void *), ptr_compare);
+    for (i = 0; i < n; i++)
+    {
+        if ((bp = ptrs[i]) == NULL)
+            continue;
+        #if MMAP_LARGE
+        if (is_mmapped(bp))
+        {
+            munmap_block(bp);
+            continue;
+        }
+        #endif
+        if ((owner = arena_of(bp)) != ar)
+        {
+            if (ar != NULL)
+                pthread_mutex_unlock(&ar->lock);
+            ar = owner;
+            pthread_mutex_lock(&ar->lock);
+        }
+        if (is_slab(bp))
+        {
+            free_block(ar, bp);
+            continue;
+        }
+        /* Join the blocks of ptrs that follow bp in the heap */
+        size = GET_SIZE(HDRP(bp));
+        while (i + 1 < n && ptrs[i+1] == bp + size && !is_slab(bp + size))
+        {
+            size += GET_SIZE(HDRP(ptrs[++i]));
+            ar->stats.nfree[choosefreetable(ptrs[i]) - 1]++;
+        }
+        if (size == GET_SIZE(HDRP(bp)))
+            free_block(ar, bp);
+        else
+        {
+            ar->stats.nfree[choosefreetable(bp) - 1]++;
+            PUT(HDRP(bp), PACK(size, 1|GET_PREV_ALLOC(HDRP(bp))));
+            merge_block(ar, bp);
+        }
+    }
+    if (ar != NULL)
+        pthread_mutex_unlock(&ar->lock);
+}
+
+/*
+ * mm_region_create - create an empty region, whose first chunk will be of
+ *                    chunk bytes (REGION_CHUNK if 0).  NULL if out of
+ *                    memory.
+ */
+struct mm_region *mm_region_create(size_t chunk)
+{
+    struct mm_region *rg;
+
+    if ((rg = malloc(sizeof(struct mm_region))) == NULL)
+        return NULL;
+    rg->chunks = NULL;
+    rg->current = NULL;
+    rg->bump = NULL;
+    rg->limit = NULL;
+    rg->chunk = chunk ? MIN(ALIGN(chunk), MAXHEAP / 2) : REGION_CHUNK;
+    return rg;
+}
+
+/*
+ * mm_region_alloc - allocate size bytes of region rg, aligned to
+ *                   ALIGNMENT
+ */
+void *mm_region_alloc(struct mm_region *rg, size_t size)
+{
+    return mm_region_memalign(rg, ALIGNMENT, size);
+}
+
+/*
+ * mm_region_memalign - allocate size bytes of region rg aligned to
+ *                      alignment, a power of two.  The bytes come from
+ *                      the current chunk by bumping a pointer; no header
+ *                      is kept, and they are only freed with the region.
+ */
+void *mm_region_memalign(struct mm_region *rg, size_t alignment, size_t size)
+{
+    uintptr_t p;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (size == 0)
+        return NULL;
+    p = ((uintptr_t)rg->bump + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (p >= (uintptr_t)rg->bump && p <= (uintptr_t)rg->limit &&
+        size <= (uintptr_t)rg->limit - p)
+    {
+        rg->bump = (char *)p + size;
+        return (void *)p;
+    }
+    return region_grow(rg, alignment, size);
+}
+
+/*
+ * region_grow - allocate size bytes aligned to alignment from a new chunk
+ *               of region rg.  A request of more than a quarter of the
+ *               next chunk gets a chunk of its own behind the current one,
+ *               which keeps serving the small requests.
+ */
+static void *region_grow(struct mm_region *rg, size_t alignment, size_t size)
+{
+    struct region_chunk *c;
+    size_t need;
+    int own;
+
+    if (alignment > MAXHEAP / 2 || size > MAXHEAP / 2)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    need = size + (alignment > ALIGNMENT ? alignment - 1 : 0);
+    own = need > rg->chunk / 4;
+    if ((c = malloc(REGION_FIRST + (own ? need : rg->chunk))) == NULL)
+        return NULL;
+    c->size = own ? need : rg->chunk;
+    if (own)
+    {
+        c->next = rg->current ? rg->current->next : rg->chunks;
+        if (rg->current)
+            rg->current->next = c;
+        else
+            rg->chunks = c;
+        return (void *)(((uintptr_t)c + REGION_FIRST + alignment - 1) &
+                        ~(uintptr_t)(alignment - 1));
+    }
+    c->next = rg->chunks;
+    rg->chunks = c;
+    rg->current = c;
+    rg->bump = (char *)c + REGION_FIRST;
+    rg->limit = rg->bump + c->size;
+    rg->chunk = MIN(2 * rg->chunk, MAX(rg->chunk, REGION_CHUNKMAX));
+    return mm_region_memalign(rg, alignment, size);
+}
+
+/*
+ * mm_region_reset - free everything allocated from region rg at once.
+ *                   The current chunk is kept for the next allocations and
+ *                   every other chunk is freed.
+ */
+void mm_region_reset(struct mm_region *rg)
+{
+    struct region_chunk *c, *next;
+
+    for (c = rg->chunks; c != NULL; c = next)
+    {
+        next = c->next;
+        if (c != rg->current)
+            free(c);
+    }
+    if ((rg->chunks = rg->current) == NULL)
+        return;
+    rg->current->next = NULL;
+    rg->bump = (char *)rg->current + REGION_FIRST;
+    rg->limit = rg->bump + rg->current->size;
+}
+
+/*
+ * mm_region_destroy - free region rg and everything allocated from it
+ */
+void mm_region_destroy(struct mm_region *rg)
+{
+    struct region_chunk *c, *next;
+
+    if (rg == NULL)
+        return;
+    for (c = rg->chunks; c != NULL; c = next)
+    {
+        next = c->next;
+        free(c);
+    }
+    free(rg);
+}
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *         and split if remainder would be at least minimum block size
+ */
+
+static void place(struct arena *ar, void *bp, size_t asize)
+
+{
+
+    size_t csize = GET_SIZE(HDRP(bp));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+    /* Only its own links are not zero if the block starts above clean */
+    size_t zeroed = (char *)bp + FREEHEAD >= ar->clean ? ZEROED : 0;
+
+    #if HEAP_TRIM
+    /* The allocated part and the remainder's links are resident now */
+    if ((char *)bp + asize + FREEHEAD > ar->trimmed)
+	ar->trimmed = (char *)PAGE_ALIGN((char *)bp + asize + FREEHEAD);
+    #endif
+    ar->clean = MAX(ar->clean, (char *)bp + asize + FREEHEAD);
+    live_add((csize - asize) >= MINBLOCK ? asize : csize);
+    if ((csize - asize) >= MINBLOCK) {
+	ar->stats.nsplit++;
+	deleteFree(ar, bp);
+	PUT(HDRP(bp), PACK(asize, 1|prev_alloc|zeroed));
+	if (!ELIDE_FOOTERS)
+	    PUT(FTRP(bp), PACK(asize, 1|zeroed));
+
+	bp = NEXT_BLKP(bp);
+	PUT(HDRP(bp), PACK(csize-asize, PREV_ALLOC));
+	PUT(FTRP(bp), GET(HDRP(bp)));
+	coalesce(ar, bp);
+
+    }
+    else {
+	deleteFree(ar, bp);
+	PUT(HDRP(bp), PACK(csize, 1|prev_alloc));
+	if (!ELIDE_FOOTERS)
+	    PUT(FTRP(bp), PACK(csize, 1));
+	SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+
+    }
+}
+
+/*
+ * pagemap_set - record arena ar as the owner of the pages of [p, p+size)
+ */
+static inline void pagemap_set(struct arena *ar, char *p, size_t size)
+{
+    #if PAGEMAP
+    memset(&PAGEMAP_AT(p), ar->index, &PAGEMAP_AT(p + size - 1) -
+                                      &PAGEMAP_AT(p) + 1);
+    #else
+    (void)ar;
+    (void)p;
+    (void)size;
+    #endif
+}
+
+/*
+ * arena_sbrk - get size more bytes of heap for arena ar, sbrk_lock held.
+ *              Returns the address just past an epilogue header of ar
+ *              followed by *size fresh bytes: the epilogue of its newest
+ *              segment while that still ends the heap, else the epilogue
+ *              of a new segment.  NULL, with errno ENOMEM, if the heap
+ *              is exhausted.  *size
+ *              is rounded up for the arena to end on a page boundary when
+ *              the heap has room for it.
+ */
+static void *arena_sbrk(struct arena *ar, size_t *size)
+{
+    char *brk = (char *)mem_heap_hi() + 1;
+    char *seg, *fresh = heap_fresh;
+    size_t pad, head, end;
+
+    /* Heap offsets and the page map cannot address beyond MAXHEAP */
+    if ((COMPACT_LINKS || PAGEMAP) &&
+        mem_heapsize() + *size + 2*GROWSIZE + SEGOVERHEAD > MAXHEAP)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    if (brk == ar->top)
+    {
+        pad = 0;
+        head = 0;
+    }
+    else
+    {
+        /*
+         * Start a new segment, on a fresh page if other arenas exist,
+         * else where its first payload is aligned
+         */
+        pad = NARENAS > 1 || HUGEPAGES ? GROW_ALIGN(brk) - (size_t)brk :
+                                         ALIGN(brk) - (size_t)brk;
+        head = SEGOVERHEAD;
+    }
+    end = GROW_ALIGN(brk + pad + head + *size);
+    if ((long)(seg = mem_sbrk(end - (size_t)brk)) != -1)
+        *size = end - (size_t)(brk + pad + head);
+    else if ((long)(seg = mem_sbrk(pad + head + *size)) == -1)
+        return NULL;
+    heap_fresh = MAX(heap_fresh, (char *)mem_heap_hi() + 1);
+    __atomic_store_n(&heap_end, (char *)mem_heap_hi() + 1, __ATOMIC_RELAXED);
+    #if HUGEPAGES
+    madvise((char *)GROW_DOWN(brk + pad),
+            (size_t)mem_heap_hi() + 1 - GROW_DOWN(brk + pad), MADV_HUGEPAGE);
+    #endif
+    #if NUMA
+    numa_bind(ar, brk + pad, (char *)mem_heap_hi() + 1);
+    #endif
+
+    if (head == 0)
+    {
+        /* The old footer and epilogue, then the new links, are not zero */
+        pagemap_set(ar, brk, *size);
+        ar->top = brk + *size;
+        ar->clean = MAX(ar->clean, MAX(brk + FREEHEAD, fresh));
+        return brk;
+    }
+    seg += pad;
+    PUT(seg, ar->lastseg ? (unsigned int)(ar->lastseg - heap_base) : 0);
+    PUT(seg + (1*WSIZE), PROLOGUE);              /* Prologue header */
+    PUT(seg + (2*WSIZE), PROLOGUE);              /* Prologue footer */
+    PUT(seg + (3*WSIZE), PACK(0, 1|PREV_ALLOC)); /* Epilogue header */
+    pagemap_set(ar, seg, SEGOVERHEAD + *size);
+    ar->lastseg = seg;
+    ar->top = seg + SEGOVERHEAD + *size;
+    ar->trimmed = seg + SEGOVERHEAD;
+    ar->clean = MAX(seg + SEGOVERHEAD + FREEHEAD, fresh);
+    return seg + SEGOVERHEAD;
+}
+
+/*
+ * extend_heap: to extend arena ar by 'words' size, ar->lock held
+ */
+
+static void *extend_heap(struct arena *ar, size_t words)
+{
+    char *bp;
+    size_t size;
+
+    /* Allocate a multiple of ALIGNMENT to maintain alignment */
+    size = ALIGN(words * WSIZE);
+    pthread_mutex_lock(&sbrk_lock);
+    bp = arena_sbrk(ar, &size);
+    pthread_mutex_unlock(&sbrk_lock);
+    if (bp == NULL)
+	return NULL;
+    ar->stats.nextend++;
+    ar->stats.extended += size;
+
+    /* Initialize free block header/footer and the epilogue header */
+    /* Free block header, inheriting the old epilogue's prev-alloc bit */
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+    PUT(FTRP(bp), GET(HDRP(bp)));         /* Free block footer */
+
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+
+    /* Coalesce if the previous block was free */
+    return coalesce(ar, bp);
+}
+
+/*
+ * coalesce - Boundary tag coalescing. Return ptr to coalesced block
+ */
+static void *coalesce(struct arena *ar, void *bp)
+{
+    size_t prev_alloc = PREV_ALLOCATED(bp);
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    /*
+     * The coalesced block always follows an allocated block, because
+     * two free blocks are never adjacent.
+     */
+    if (prev_alloc && next_alloc) {            /* Case 1 */
+	ar->stats.ncoalesce[0]++;
+	insertFree(ar, bp);
+    }
+
+    else if (prev_alloc && !next_alloc) {      /* Case 2 */
+	ar->stats.ncoalesce[1]++;
+
+	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+	deleteFree(ar, NEXT_BLKP(bp));
+    PUT(HDRP(bp), PACK(size,PREV_ALLOC));
+	PUT(FTRP(bp), PACK(size,PREV_ALLOC));
+	insertFree(ar, bp);
+    }
+
+    else if (!prev_alloc && next_alloc) {      /* Case 3 */
+	ar->stats.ncoalesce[2]++;
+	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+	deleteFree(ar, PREV_BLKP(bp));
+	PUT(FTRP(bp), PACK(size, PREV_ALLOC));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, PREV_ALLOC));
+	bp = PREV_BLKP(bp);
+	insertFree(ar, bp);
+    }
+
+    else {                                     /* Case 4 */
+	ar->stats.ncoalesce[3]++;
+	size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
+	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
+	deleteFree(ar, PREV_BLKP(bp));
+	deleteFree(ar, NEXT_BLKP(bp));
+	PUT(HDRP(PREV_BLKP(bp)), PACK(size, PREV_ALLOC));
+	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, PREV_ALLOC));
+	bp = PREV_BLKP(bp);
+	insertFree(ar, bp);
+    }
+
+    #if HEAP_TRIM
+    /* Release the top block once enough of it is resident */
+    if (NEXT_BLKP(bp) == ar->top &&
+        ar->trimmed > (char *)bp + TRIM_THRESHOLD)
+    {
+        ar->stats.released += release_block(bp, 0, ar->trimmed);
+        ar->trimmed = (char *)PAGE_ALIGN((char *)bp + FREEHEAD);
+    }
+    #endif
+    return bp;
+}
+
+/*
+ * release_block - give the whole pages (GROWSIZE) of free block bp
+ *                 between its first pad bytes and limit back to the OS,
+ *                 keeping its header, links and footer.  Returns the
+ *                 number of bytes released.
+ */
+static size_t release_block(void *bp, size_t pad, char *limit)
+{
+    char *lo = (char *)GROW_ALIGN((char *)bp + MAX(pad, FREEHEAD));
+    char *hi = (char *)GROW_DOWN(FTRP(bp));
+
+    if (hi > limit)
+        hi = (char *)GROW_ALIGN(limit);
+    if (lo >= hi)
+        return 0;
+    madvise(lo, hi - lo, MADV_DONTNEED);
+    return hi - lo;
+}
+
+/*
+ * mm_trim - give the pages of every free block back to the OS, except
+ *           for the first pad bytes of each arena's top block.  The fast
+ *           bins are coalesced, and the cached slabs freed, first.
+ *           Returns 1 if any memory was released, 0 otherwise.
+ */
+int mm_trim(size_t pad)
+{
+    struct arena *ar;
+    size_t released = 0, before;
+    void *bp;
+    int i, n;
+
+    if (arenas == NULL)
+        return 0;
+    for (i = 0; i < NARENAS; i++)
+    {
+        ar = &arenas[i];
+        pthread_mutex_lock(&ar->lock);
+        remote_drain(ar);
+        #if FASTBINS
+        fastbin_consolidate(ar);
+        #endif
+        #if SLAB
+        slab_uncache(ar);
+        #endif
+        before = ar->stats.released;
+        for (n = 1; n <= MAXFREESIZE; n++)
+        {
+            for (bp = ar->freelist[n-1]; bp != NULL; bp = NEXT_FREE(bp))
+            {
+                if (NEXT_BLKP(bp) != ar->top)
+                    ar->stats.released += release_block(bp, 0, ar->top);
+                else
+                {
+                    ar->stats.released += release_block(bp, pad, ar->top);
+                    ar->trimmed = MIN(ar->trimmed, (char *)PAGE_ALIGN(
+                        (char *)bp + MAX(pad, FREEHEAD)));
+                }
+            }
+        }
+        released += ar->stats.released - before;
+        pthread_mutex_unlock(&ar->lock);
+    }
+    return released != 0;
+}
+
+/*
+ * mm_stats - fill st with a snapshot of the counters of all arenas and
+ *            mapped blocks, and of the calling thread's cache.  The
+ *            caches of other threads add their counts to an arena when
+ *            they next refill or flush a bin.  Returns 0, or -1 if there
+ *            is no heap yet.
+ */
+int mm_stats(struct mm_stats *st)
+{
+    struct mm_stats *as;
+    int i, n;
+
+    memset(st, 0, sizeof(*st));
+    if (arenas == NULL)
+        return -1;
+    for (i = 0; i < NARENAS; i++)
+    {
+        pthread_mutex_lock(&arenas[i].lock);
+        as = &arenas[i].stats;
+        st->released += as->released;
+        for (n = 0; n < MAXFREESIZE; n++)
+        {
+            st->nmalloc[n] += as->nmalloc[n];
+            st->nfree[n] += as->nfree[n];
+        }
+        st->nsearch += as->nsearch;
+        st->nprobe += as->nprobe;
+        st->nsplit += as->nsplit;
+        for (n = 0; n < 4; n++)
+            st->ncoalesce[n] += as->ncoalesce[n];
+        st->nextend += as->nextend;
+        st->extended += as->extended;
+        st->nlocal += as->nlocal;
+        st->nremote += as->nremote;
+        pthread_mutex_unlock(&arenas[i].lock);
+    }
+    /* The break moves under sbrk_lock */
+    pthread_mutex_lock(&sbrk_lock);
+    st->heap = mem_heapsize();
+    pthread_mutex_unlock(&sbrk_lock);
+    st->live = __atomic_load_n(&live_stats.live, __ATOMIC_RELAXED);
+    st->peak = __atomic_load_n(&live_stats.peak, __ATOMIC_RELAXED);
+    st->mapped = __atomic_load_n(&map_stats.mapped, __ATOMIC_RELAXED);
+    st->mapped_peak = __atomic_load_n(&map_stats.mapped_peak,
+                                      __ATOMIC_RELAXED);
+    st->nmmap = __atomic_load_n(&map_stats.nmmap, __ATOMIC_RELAXED);
+    st->nmunmap = __atomic_load_n(&map_stats.nmunmap, __ATOMIC_RELAXED);
+    #if TCACHE
+    if (tcache != NULL && tcache->gen == heap_gen)
+    {
+        st->tcache_hits = tcache->hits;
+        st->tcache_puts = tcache->puts;
+        for (n = 0; n < MAXFREESIZE; n++)
+        {
+            st->nmalloc[n] += tcache->nmalloc[n];
+            st->nfree[n] += tcache->nfree[n];
+        }
+    }
+    #endif
+    return 0;
 }
 
 /*
- *  choosefreetable:
- *  Choose the most appropriate table number
- *  based on the block pointer as argument
+ * mm_stats_print - write a mm_stats snapshot to fp, with a line for
+ *                  every list that has blocks handed out or freed
  */
-
-static inline int choosefreetable(void * bp)
+void mm_stats_print(FILE *fp)
 {
-    int freeblksize;
-    int numresult;
-    freeblksize = (int)GET_SIZE(HDRP(bp));
-    numresult = choosefreetable_bysize(freeblksize);
-    return numresult;
+    static const unsigned int bound[MAXFREESIZE - 1] = {
+        LIST1, LIST2, LIST3, LIST4, LIST5, LIST6, LIST7, LIST8, LIST9,
+        LIST10, LIST11, LIST12, LIST13, LIST14, LIST15, LIST16, LIST17
+    };
+    struct mm_stats st;
+    int n;
 
+    if (mm_stats(&st) < 0)
+        return;
+    fprintf(fp, "heap       %zu bytes, %zu released\n", st.heap, st.released);
+    fprintf(fp, "live       %zu bytes, peak %zu\n", st.live, st.peak);
+    fprintf(fp, "mapped     %zu bytes, peak %zu, %lu maps, %lu unmaps\n",
+            st.mapped, st.mapped_peak, st.nmmap, st.nmunmap);
+    fprintf(fp, "extended   %lu times, %zu bytes\n", st.nextend, st.extended);
+    fprintf(fp, "searches   %lu, %.2f blocks probed each, %lu splits\n",
+            st.nsearch, st.nsearch ? (double)st.nprobe / st.nsearch : 0.0,
+            st.nsplit);
+    fprintf(fp, "coalesce   %lu %lu %lu %lu (cases 1 to 4)\n",
+            st.ncoalesce[0], st.ncoalesce[1], st.ncoalesce[2],
+            st.ncoalesce[3]);
+    fprintf(fp, "tcache     %lu hits, %lu puts (this thread)\n",
+            st.tcache_hits, st.tcache_puts);
+    fprintf(fp, "numa       %lu local, %lu remote allocations\n",
+            st.nlocal, st.nremote);
+    fprintf(fp, "list   up to bytes      mallocs        frees\n");
+    for (n = 0; n < MAXFREESIZE; n++)
+    {
+        if (st.nmalloc[n] == 0 && st.nfree[n] == 0)
+            continue;
+        if (n < MAXFREESIZE - 1)
+            fprintf(fp, "%4d %14u %12lu %12lu\n", n + 1, bound[n] * DSIZE,
+                    st.nmalloc[n], st.nfree[n]);
+        else
+            fprintf(fp, "%4d %14s %12lu %12lu\n", n + 1, "more",
+                    st.nmalloc[n], st.nfree[n]);
+    }
 }
 
 /*
- *  choosefreetable_bysize:
- *  Choose the most appropriate table number
- *  based on the block size as argument
- */
-static inline int choosefreetable_bysize(int freeblksize)
-{
-    int numresult;
-    int temp = freeblksize/DSIZE;
-    if (temp<=LIST1)  numresult = 1;
-    else if (temp <=LIST2) numresult = 2;
-    else if (temp <=LIST3) numresult = 3;
-    else if (temp <=LIST4) numresult = 4;
-    else if (temp <=LIST5) numresult = 5;
-    else if (temp <=LIST6) numresult = 6;
-    else if (temp <=LIST7) numresult = 7;
-    else if (temp <=LIST8) numresult = 8;
-    else if (temp <=LIST9) numresult = 9;
-    else if (temp <=LIST10) numresult = 10;
-    else if (temp <=LIST11) numresult = 11;
-    else if (temp <=LIST12) numresult = 12;
-    else if (temp <=LIST13) numresult = 13;
-    else if (temp <=LIST14) numresult = 14;
-    else if (temp <=LIST15) numresult = 15;
-    else if (temp <=LIST16) numresult = 16;
-    else if (temp <=LIST17) numresult = 17;
-
-    else numresult =18;
-    return numresult;
+ * profile_alloc - count size bytes of block bp against the countdown of
+ *                 the calling thread, and sample bp once it runs out.
+ *                 Returns bp.
+ */
+static inline void *profile_alloc(void *bp, size_t size)
+{
+    #if PROFILE
+    if ((prof_countdown -= (long)size) < 0 && bp != NULL)
+        profile_sample(bp, size);
+    #else
+    (void)size;
+    #endif
+    return bp;
 }
 
 /*
- * deleteFree:
- * Delete one node from the free list
- * and link the pre to next.
+ * profile_free - drop block bp, about to be freed, from the samples.
+ *                Only a block of a page holding some searches the table.
  */
-
-static inline void deleteFree(void *bp)
+static inline void profile_free(void *bp)
 {
-    void * pre_f;
-    void * next_f;
-    int FreetableN = choosefreetable(bp);
-    freelisthead = (void *)GETLP((char*)freelisttablehead
-                                 + DSIZE * (FreetableN-1));
-
+    #if PROFILE
+    if (__atomic_load_n(&prof_nlive, __ATOMIC_ACQUIRE) != 0 &&
+        (!PROFILE_PAGED(bp) ||
+         __atomic_load_n(&PROFILE_PAGE(bp), __ATOMIC_RELAXED) != 0))
+        profile_forget(bp);
+    #else
+    (void)bp;
+    #endif
+}
 
-    pre_f = PREV_FREE(bp);
-    next_f= NEXT_FREE(bp);
-    if (pre_f!=NULL)
-    {
-        PUTLP(((char*)pre_f+DSIZE),next_f);
-    }
-    else
+/*
+ * profile_resize - realloc moved or resized oldptr to newptr of size
+ *                  bytes, in place if they are equal: sample it as a new
+ *                  block.  Returns newptr.
+ */
+static inline void *profile_resize(void *oldptr, void *newptr, size_t size)
+{
+    if (newptr != NULL)
     {
-        PUTLP((char*)freelisttablehead + DSIZE * (FreetableN-1),next_f);
+        profile_free(oldptr);
+        profile_alloc(newptr, size);
     }
-    if (next_f!=NULL) PUTLP((next_f),pre_f);
+    return newptr;
 }
 
+/*
+ * mm_profile - sample one allocation per rate bytes on average, or none
+ *              if rate is 0.  Each thread takes the new rate at its next
+ *              sample.  Returns 0, or -1 without PROFILE.
+ */
+int mm_profile(size_t rate)
+{
+    #if PROFILE
+    __atomic_store_n(&prof_rate, rate, __ATOMIC_RELAXED);
+    return 0;
+    #else
+    (void)rate;
+    return -1;
+    #endif
+}
 
 /*
- * free---To free a block with necessary inserting & coalescing action
+ * mm_profile_dump - write the live samples to fp as a pprof heap profile
+ *                   (heap_v2, which pprof scales back by the rate),
+ *                   followed by the mappings of the process.  Returns the
+ *                   number of samples, or -1 on error or without PROFILE.
  */
-void free (void *ptr) {
+int mm_profile_dump(FILE *fp)
+{
+    #if PROFILE
+    size_t len = PROFILE_SLOTS * sizeof(struct prof_sample);
+    size_t bytes = 0, rate = __atomic_load_n(&prof_rate, __ATOMIC_RELAXED);
+    struct prof_sample *copy;
+    unsigned long n = 0;
+    char buf[4096];
+    ssize_t got;
+    int fd, i, k;
 
-	void * new_ptr;
-	if (ptr != NULL)
-	{
-	    size_t fsize = GET_SIZE(HDRP(ptr));
+    /* Print a copy: stdio may malloc, and free needs prof_lock */
+    copy = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS,
+                -1, 0);
+    if (copy == MAP_FAILED)
+        return -1;
+    pthread_mutex_lock(&prof_lock);
+    if (prof_table != NULL)
+        memcpy(copy, prof_table, len);
+    pthread_mutex_unlock(&prof_lock);
 
-	    PUT(HDRP(ptr), PACK(fsize,0));
-            PUT(FTRP(ptr), PACK(fsize,0));
-            new_ptr = coalesce(ptr);
-            #ifdef Debug
-            if (Verbose) mm_checkheap(1);
-            else mm_checkheap(0);
-            #endif
-    	}
-    else
+    for (i = 0; i < PROFILE_SLOTS; i++)
     {
-        return;
+        if (copy[i].bp != NULL)
+        {
+            n++;
+            bytes += copy[i].size;
+        }
+    }
+    fprintf(fp, "heap profile: %lu: %zu [%lu: %zu] @ heap_v2/%zu\n",
+            n, bytes, n, bytes, rate);
+    for (i = 0; i < PROFILE_SLOTS; i++)
+    {
+        if (copy[i].bp == NULL)
+            continue;
+        fprintf(fp, "1: %zu [1: %zu] @", copy[i].size, copy[i].size);
+        /* Frame 0 is profile_sample */
+        for (k = 1; k < copy[i].depth; k++)
+            fprintf(fp, " %p", copy[i].stack[k]);
+        fprintf(fp, "\n");
     }
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+    if ((fd = open("/proc/self/maps", O_RDONLY)) >= 0)
+    {
+        while ((got = read(fd, buf, sizeof(buf))) > 0)
+            fwrite(buf, 1, got, fp);
+        close(fd);
+    }
+    munmap(copy, len);
+    return (int)n;
+    #else
+    (void)fp;
+    return -1;
+    #endif
 }
 
-
-
+#if PROFILE
 /*
- * realloc - you may want to look at mm-naive.c
+ * profile_sample - the countdown of the calling thread ran out at block
+ *                  bp of size bytes: record bp with its stack, and draw
+ *                  the bytes to the next sample
  */
-void *realloc(void *oldptr, size_t size)
+static void profile_sample(void *bp, size_t size)
 {
-    size_t oldsize;
-    void *newptr;
+    size_t rate = __atomic_load_n(&prof_rate, __ATOMIC_RELAXED);
+    size_t len = PROFILE_SLOTS * sizeof(struct prof_sample);
+    struct prof_sample *sp;
+    void *stack[PROFILE_DEPTH];
+    int depth;
 
-    /* If size == 0 then this is just free, and we return NULL. */
-    if(size == 0)
+    if (prof_busy)
+        return;
+    prof_busy = 1;
+    if (rate == 0)
     {
-        free(oldptr);
-        return 0;
+        prof_countdown = PROFILE_RECHECK;
+        prof_busy = 0;
+        return;
     }
-
-    /* If oldptr is NULL, then this is just malloc. */
-    if(oldptr == NULL)
+    if (prof_seed == 0)
     {
-        return malloc(size);
+        /* The first countdown of a thread is 0: only draw a real one */
+        prof_seed = ((unsigned int)(uintptr_t)&prof_seed * 2654435761u) | 1;
+        prof_countdown = profile_interval(rate);
+        prof_busy = 0;
+        return;
     }
+    depth = backtrace(stack, PROFILE_DEPTH);
+    prof_countdown = profile_interval(rate);
 
-       /* Copy the old data. */
-    oldsize = GET_SIZE(HDRP(oldptr));
-    if (size <= DSIZE)
-        size = 3*DSIZE; //size adjust
-    else
-        size = DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
-
-
-    if(size <= oldsize)
+    pthread_mutex_lock(&prof_lock);
+    if (prof_table == NULL)
     {
-        return oldptr;
+        prof_table = mmap(NULL, len, PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        prof_pages = mmap(NULL, PAGEMAP_SIZE, PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (prof_table == MAP_FAILED || prof_pages == MAP_FAILED)
+        {
+            if (prof_table != MAP_FAILED)
+                munmap(prof_table, len);
+            if (prof_pages != MAP_FAILED)
+                munmap(prof_pages, PAGEMAP_SIZE);
+            prof_table = NULL;
+            prof_pages = NULL;
+        }
     }
-    else
+    /* Keep the table at most 3/4 full; a sample more is dropped */
+    if (prof_table != NULL && prof_nlive < PROFILE_SLOTS / 4 * 3)
     {
-        newptr = malloc(size);
-    /* If realloc() fails the original block is left untouched  */
-        if(!newptr)
+        for (sp = &prof_table[PROFILE_HASH(bp)];
+             sp->bp != NULL && sp->bp != bp;
+             sp = &prof_table[(sp - prof_table + 1) & (PROFILE_SLOTS - 1)])
+            ;
+        if (sp->bp == NULL)
         {
-            return 0;
+            if (PROFILE_PAGED(bp) &&
+                __atomic_load_n(&PROFILE_PAGE(bp), __ATOMIC_RELAXED) < 255)
+                __atomic_fetch_add(&PROFILE_PAGE(bp), 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&prof_nlive, prof_nlive + 1, __ATOMIC_RELEASE);
         }
-        memcpy(newptr, oldptr, oldsize);
-        /* Free the old block. */
-        free(oldptr);
-        return newptr;
+        sp->bp = bp;
+        sp->size = size;
+        sp->depth = depth;
+        memcpy(sp->stack, stack, depth * sizeof(void *));
     }
-
-}
-
-/*
- * calloc - you may want to look at mm-naive.c
- * This function is not tested by mdriver, but it is
- * needed to run the traces.
- */
-void *calloc (size_t nmemb, size_t size) {
-    size_t bytes = nmemb * size;
-    void *newptr;
-
-    newptr = malloc(bytes);
-    memset(newptr, 0, bytes);
-
-    return newptr;
+    pthread_mutex_unlock(&prof_lock);
+    prof_busy = 0;
 }
 
 /*
- * place - Place block of asize bytes at start of free block bp
- *         and split if remainder would be at least minimum block size
+ * profile_forget - remove block bp from the table if it was sampled,
+ *                  closing the gap it leaves in its probe sequence
  */
-
-static void place(void *bp, size_t asize)
-
+static void profile_forget(void *bp)
 {
-
-    size_t csize = GET_SIZE(HDRP(bp));
-
-    if ((csize - asize) >= (3*DSIZE)) {
-	deleteFree(bp);
-	PUT(HDRP(bp), PACK(asize, 1));
-	PUT(FTRP(bp), PACK(asize, 1));
-
-	bp = NEXT_BLKP(bp);
-	PUT(HDRP(bp), PACK(csize-asize, 0));
-	PUT(FTRP(bp), PACK(csize-asize, 0));
-	coalesce(bp);
-
+    size_t i, j, k;
+    pthread_mutex_lock(&prof_lock);
+    for (i = PROFILE_HASH(bp);
+         prof_table[i].bp != NULL && prof_table[i].bp != bp;
+         i = (i + 1) & (PROFILE_SLOTS - 1))
+        ;
+    if (prof_table[i].bp == NULL)
+    {
+        pthread_mutex_unlock(&prof_lock);
+        return;
     }
-    else {
-	deleteFree(bp);
-	PUT(HDRP(bp), PACK(csize, 1));
-	PUT(FTRP(bp), PACK(csize, 1));
-
+    if (PROFILE_PAGED(bp) &&
+        __atomic_load_n(&PROFILE_PAGE(bp), __ATOMIC_RELAXED) < 255)
+        __atomic_fetch_sub(&PROFILE_PAGE(bp), 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&prof_nlive, prof_nlive - 1, __ATOMIC_RELAXED);
+    /* Move back every later sample of the run its own slot allows */
+    for (j = i; ; )
+    {
+        j = (j + 1) & (PROFILE_SLOTS - 1);
+        if (prof_table[j].bp == NULL)
+            break;
+        k = PROFILE_HASH(prof_table[j].bp);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        prof_table[i] = prof_table[j];
+        i = j;
     }
+    prof_table[i].bp = NULL;
+    pthread_mutex_unlock(&prof_lock);
 }
 
 /*
- * extend_heap: to extend the heap by 'words' size
+ * profile_interval - bytes to the next sample: exponential with mean
+ *                    rate, as -ln(u) * rate for u uniform in (0, 1]
  */
-
-static void *extend_heap(size_t words)
+static long profile_interval(size_t rate)
 {
-    char *bp;
-    size_t size;
-
-    /* Allocate an even number of words to maintain alignment */
-    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-    if ((long)(bp = mem_sbrk(size)) == -1)
-	return NULL;
-
-    /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
+    unsigned int x = prof_seed, u;
+    double log2u;
+    int msb;
 
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
-
-    /* Coalesce if the previous block was free */
-    return coalesce(bp);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    prof_seed = x;
+    u = (x >> 6) + 1;                   /* u * 2^26 */
+    msb = 31 - __builtin_clz(u);
+    /* log2 with a linear mantissa, off by at most 0.09 */
+    log2u = msb + (double)(u - (1u << msb)) / (1u << msb) - 26;
+    return (long)(-log2u * 0.6931471805599453 * rate) + 1;
 }
 
 /*
- * coalesce - Boundary tag coalescing. Return ptr to coalesced block
+ * profile_reset - forget every sample, the heap being made anew
  */
-static void *coalesce(void *bp)
+static void profile_reset(void)
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
-    size_t size = GET_SIZE(HDRP(bp));
-
-    if (prev_alloc && next_alloc) {            /* Case 1 */
-	insertFree(bp);
-	return bp;
-    }
-
-    else if (prev_alloc && !next_alloc) {      /* Case 2 */
-
-	size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-	deleteFree(NEXT_BLKP(bp));
-    PUT(HDRP(bp), PACK(size,0));
-	PUT(FTRP(bp), PACK(size,0));
-	insertFree(bp);
-    }
-
-    else if (!prev_alloc && next_alloc) {      /* Case 3 */
-	size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-	deleteFree(PREV_BLKP(bp));
-	PUT(FTRP(bp), PACK(size, 0));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	bp = PREV_BLKP(bp);
-	insertFree(bp);
-    }
-
-    else {                                     /* Case 4 */
-	size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
-	    GET_SIZE(FTRP(NEXT_BLKP(bp)));
-	deleteFree(PREV_BLKP(bp));
-	deleteFree(NEXT_BLKP(bp));
-	PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-	PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-	bp = PREV_BLKP(bp);
-	insertFree(bp);
+    pthread_mutex_lock(&prof_lock);
+    if (prof_table != NULL)
+    {
+        madvise(prof_table, PROFILE_SLOTS * sizeof(struct prof_sample),
+                MADV_DONTNEED);
+        madvise(prof_pages, PAGEMAP_SIZE, MADV_DONTNEED);
     }
-
-    return bp;
+    __atomic_store_n(&prof_nlive, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&prof_lock);
 }
+#endif /* PROFILE */
 
 
 
 /*
  * find_fit - Find a fit for a block with asize bytes
+ *            in arena ar.  Only non-empty lists are visited: the
+ *            arena's freelistbitmap gives the next candidate list with
+ *            a single bit scan.  Every block of a list above the one of
+ *            asize fits, so a list holding a fit never has a better
+ *            one after it.  The tree of the last list always gives its
+ *            best fit.  The cached size of a head spares reading it when
+ *            it fits at once, and the walk prefetches the header of the
+ *            next block while it looks at one.
  */
 
-static void *find_fit(size_t asize)
+static void *find_fit(struct arena *ar, size_t asize)
 {
 
-    /* First fit search */
-    void *bp;
-    int FreetableN = choosefreetable_bysize((int)asize);
-    int i;
-    for  (i = FreetableN; i<MAXFREESIZE ;i++ )
+    void *bp, *best;
+    int FreetableN = choosefreetable_bysize(asize);
+    int i, probes;
+    unsigned int candidates = ar->freelistbitmap & ~(LISTBIT(FreetableN) - 1);
+    ar->stats.nsearch++;
+    while (candidates)
      {
-         freelisthead = (void *)GETLP((char*)freelisttablehead + DSIZE * (i-1));
-         for (bp =freelisthead;
+         i = __builtin_ctz(candidates) + 1;
+         candidates &= candidates - 1;
+         #if LARGE_TREE
+         if (i == MAXFREESIZE)
+             return tree_fit(ar, asize);
+         #endif
+         best = NULL;
+         probes = 0;
+         if (asize <= ar->headsize[i-1] &&
+             (fit_policy == FIT_FIRST || ar->headsize[i-1] == asize))
+         {
+             ar->stats.nprobe++;
+             return ar->freelist[i-1];
+         }
+         for (bp = ar->freelist[i-1];
               bp!=NULL && GET_SIZE(HDRP(bp)) > 0;
               bp = NEXT_FREE(bp))
          {
-
+	          ar->stats.nprobe++;
+	          if (NEXT_FREE(bp) != NULL)
+	              __builtin_prefetch(HDRP(NEXT_FREE(bp)));
 	          if  ( !GET_ALLOC(HDRP(bp)) && asize <= GET_SIZE(HDRP(bp)))
               {
-	              return bp;
+	              /* First fit search */
+	              if (fit_policy == FIT_FIRST || GET_SIZE(HDRP(bp)) == asize)
+	                  return bp;
+	              /* Bounded best fit or exact fit search */
+	              if (best == NULL || (fit_policy == FIT_BEST &&
+	                                   GET_SIZE(HDRP(bp)) < GET_SIZE(HDRP(best))))
+	                  best = bp;
+	              if (++probes >= fit_probes)
+	                  break;
 	          }
 
           }
+         if (best != NULL)
+             return best;
      }
     return NULL; /* No fit */
 
 }
+
+/*
+ * mm_fit_policy - choose how free blocks are searched (FIT_FIRST,
+ *                 FIT_BEST probing up to probes fits, or FIT_EXACT).
+ *                 Meant to be called before mm_init.  Returns 0, or -1
+ *                 for an unknown policy.
+ */
+int mm_fit_policy(int policy, int probes)
+{
+    if (policy != FIT_FIRST && policy != FIT_BEST && policy != FIT_EXACT)
+        return -1;
+    fit_policy = policy;
+    fit_probes = probes > 0 ? probes : FIT_PROBES;
+    return 0;
+}
+
 /*
  * printblock - Used for checking only, to print block information
  */
@@ -555,7 +3666,7 @@ static void *find_fit(size_t asize)
 static void printblock(void *bp)
 {
     size_t hsize, halloc, fsize, falloc;
-    mm_checkheap(0);
+    checkheap(arena_of(bp), 0);
     hsize = GET_SIZE(HDRP(bp));
     halloc = GET_ALLOC(HDRP(bp));
     fsize = GET_SIZE(FTRP(bp));
@@ -568,15 +3679,17 @@ static void printblock(void *bp)
 
 }
 /*
- * in_heap: used for checking only
- *          Return whether the pointer is in the heap.
+ * in_heap: Return whether the pointer is in the heap.  The end of the
+ *          heap is read from heap_end, as callers like free do not hold
+ *          sbrk_lock.
  *
  */
 
 
 static int in_heap(const void *p)
 {
-    return p <= mem_heap_hi() && p >= mem_heap_lo();
+    return (const char *)p < __atomic_load_n(&heap_end, __ATOMIC_RELAXED) &&
+           p >= mem_heap_lo();
 }
 
 
@@ -618,33 +3731,64 @@ static void checkblock(void *bp)
 {
     if (!in_heap(bp) )
         printf("Error: %p is out of boundary\n",bp);
-    if (GET_SIZE(HDRP(bp)) <3*DSIZE && bp != heap_listp )
+    if (GET_SIZE(HDRP(bp)) <MINBLOCK && GET(HDRP(bp)) != PROLOGUE )
         printf("Error: %p has a wrong size\n",bp);
-    if ((size_t)bp % DSIZE)
-	    printf("Error: %p is not doubleword aligned\n", bp);
-    if (GET(HDRP(bp)) != GET(FTRP(bp)))
+    if ((size_t)bp % ALIGNMENT && GET(HDRP(bp)) != PROLOGUE)
+	    printf("Error: %p is not aligned\n", bp);
+    /* allocated blocks have no footer with ELIDE_FOOTERS */
+    if ((!ELIDE_FOOTERS || !GET_ALLOC(HDRP(bp)) || GET(HDRP(bp)) == PROLOGUE) &&
+        GET(HDRP(bp)) != GET(FTRP(bp)))
 	    printf("Error: header does not match footer\n");
+    /* the next header must know whether this block is allocated */
+    if (ELIDE_FOOTERS && !GET_PREV_ALLOC(HDRP(NEXT_BLKP(bp))) !=
+        !GET_ALLOC(HDRP(bp)))
+	    printf("Error: prev-alloc bit after %p is wrong\n", bp);
 }
 
 /*
  * mm_checkheap--to chech if the freeblock list and heap structure is OK
+ *               in every arena, and the calling thread's cache
  */
 int mm_checkheap(int verbose) {
-    char *bp = heap_listp;
+    int i;
+    if (arenas == NULL)
+        return 0;
+    for (i = 0; i < NARENAS; i++)
+    {
+        pthread_mutex_lock(&arenas[i].lock);
+        checkheap(&arenas[i], verbose);
+        pthread_mutex_unlock(&arenas[i].lock);
+    }
+    #if TCACHE
+    checktcache();
+    #endif
+    return 0;
+}
+
+/*
+ * checkheap - check the segments and free lists of arena ar,
+ *             ar->lock held
+ */
+static int checkheap(struct arena *ar, int verbose) {
+    char *bp;
+    char *seg; /*segment start*/
     void *fp;  /*free block pointer*/
     int index; /*index in the free list*/
     int fblocknumbynormal=0; /*count the free blocks by iteration*/
     int fblocknumbyfreelist=0;/*count the free blocks by list pointer*/
+    #if SLAB
+    struct slab *sl; /*slab of the arena*/
+    #endif
 
+    for (seg = ar->lastseg; seg != NULL;
+         seg = GET(seg) ? heap_base + GET(seg) : NULL)
+    {
+    bp = seg + 2*WSIZE;
     /*check1:  Prologue block*/
-    if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) ||
-         !GET_ALLOC(HDRP(heap_listp)))
+    if (GET(HDRP(bp)) != PROLOGUE || GET(FTRP(bp)) != PROLOGUE)
 	printf("Bad prologue header\n");
 
-    checkblock(heap_listp);
-
-
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+    for (; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
     {
 	     if (verbose)
              printblock(bp);
@@ -654,6 +3798,9 @@ int mm_checkheap(int verbose) {
             printf("consecutive free block! @,(%p)",bp);
 	     /*check3:  every block's alignment & header-footer & boundaries*/
 	     checkblock(bp);
+	     /*check 3.1: if the page map gives the block to this arena*/
+	     if (arena_of(bp) != ar)
+            printf("Error: block %p is mapped to another arena\n",bp);
 	     if (!GET_ALLOC(HDRP(bp)))
          {
              fblocknumbynormal++;
@@ -667,23 +3814,163 @@ int mm_checkheap(int verbose) {
 	/*check4:  Epilogue block*/
     if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
 	printf("Bad epilogue header\n");
+    /*check 4.1: the newest segment ends at the arena top*/
+    if (seg == ar->lastseg && (char *)bp != ar->top)
+	printf("Error: arena %u does not end at its top\n", ar->index);
+    }
+
+    /*check 4.2: queued remote frees are allocated blocks of this arena*/
+    for (fp = __atomic_load_n(&ar->remote, __ATOMIC_ACQUIRE); fp != NULL;
+         fp = GETLP(fp))
+    {
+        if (!in_heap(fp) || (!is_slab(fp) && !GET_ALLOC(HDRP(fp))) ||
+            arena_of(fp) != ar)
+            printf("Error: bad block %p in remote free queue\n",fp);
+    }
+
+    #if SLAB
+    /*check 4.3: slabs on the lists are flagged and have free objects*/
+    for (index = 0; index < (int)SLAB_CLASSES; index++)
+    {
+        for (sl = ar->slabs[index]; sl != NULL; sl = sl->next)
+        {
+            unsigned int nfree = (sl->nobjs * sl->size -
+                                  (sl->bump - (char *)sl - SLAB_FIRST)) /
+                                 sl->size;
+            if (!is_slab(sl) || arena_of(sl) != ar ||
+                SLAB_CLASS(sl->size) != (size_t)index)
+                printf("Error: bad slab %p\n",sl);
+            for (fp = sl->freeobj; fp != NULL; fp = GETLP(fp))
+            {
+                if (SLAB_OF(fp) != sl)
+                    printf("Error: object %p on the wrong slab\n",fp);
+                nfree++;
+            }
+            if (nfree != sl->nfree || nfree == 0 ||
+                (sl->next != NULL && sl->next->prev != sl))
+                printf("Error: slab %p miscounted\n",sl);
+        }
+    }
+    /*check 4.3.1: cached slabs are flagged blocks of this arena*/
+    index = 0;
+    for (sl = ar->slabcache; sl != NULL; sl = sl->next, index++)
+    {
+        if (!is_slab(sl) || arena_of(sl) != ar ||
+            !GET_ALLOC(HDRP(sl)) || GET_SIZE(HDRP(sl)) < SLABSIZE)
+            printf("Error: bad cached slab %p\n",sl);
+    }
+    if (index != (int)ar->nslabcache || index > SLAB_CACHE)
+        printf("Error: slab cache of arena %u miscounted\n",ar->index);
+    #endif
+
+    #if FASTBINS
+    /*check 4.4: fast bins hold allocated blocks of their size*/
+    for (index = 0; index < (int)FASTBIN_BINS; index++)
+    {
+        if ((ar->fastbin[index] != NULL) !=
+            ((ar->fastbinmap & FASTBIT(index)) != 0))
+            printf("Error: bitmap of fast bin %d is out of date\n",index);
+        for (fp = ar->fastbin[index]; fp != NULL; fp = GETLP(fp))
+        {
+            if (!in_heap(fp) || is_slab(fp) || !GET_ALLOC(HDRP(fp)) ||
+                FASTBIN_BIN(GET_SIZE(HDRP(fp))) != (size_t)index ||
+                arena_of(fp) != ar)
+                printf("Error: bad block %p in fast bin\n",fp);
+        }
+    }
+    #endif
+
+    /*check 4.5: the heap above clean is zero*/
+    for (bp = ar->clean; ar->top != NULL && bp < ar->top - DSIZE; bp++)
+    {
+        if (*bp != 0)
+        {
+            printf("Error: arena %u is not zero at %p\n", ar->index, bp);
+            break;
+        }
+    }
+
+    /*check 5.10: the lookup table, maybe generated, matches the bounds*/
+    for (index = 0; index <= SMALLCLASS_MAX; index++)
+    {
+        if (sizeclass_table[index] != SIZECLASS_OF(index))
+        {
+            printf("Error: size class table is wrong at %d units\n",index);
+            break;
+        }
+    }
 
     /*check5: every free block is correct*/
-    for  (index = 1; index<MAXFREESIZE ;index++ )
+    for  (index = 1; index<=MAXFREESIZE ;index++ )
     {
-         for (fp = (void *)GETLP((char*)freelisttablehead + DSIZE * (index-1));
+         /*check 5.6 : if the list bitmap agrees with the list head*/
+         fp = ar->freelist[index-1];
+         if ((fp != NULL) != ((ar->freelistbitmap & LISTBIT(index)) != 0))
+             printf("Error: bitmap of free list %d is out of date\n",index);
+         /*check 5.11 : if the cached size of the list head is its size*/
+         if (ar->headsize[index-1] != (fp ? GET_SIZE(HDRP(fp)) : 0))
+             printf("Error: cached head size of free list %d is out of "
+                    "date\n",index);
+         for (fp = ar->freelist[index-1];
               fp!= NULL && GET_SIZE(HDRP(fp)) > 0;
               fp = NEXT_FREE(fp))
          {
             checkFreeBlock(fp);
             fblocknumbyfreelist++;
             /*check 5.4 : if each free block is in the correct free list*/
-            if (choosefreetable(fp)!=index)
+            if (choosefreetable(fp)!=index || arena_of(fp) != ar)
                 printf("The free block %p is in the wrong free list\n",fp);
+            #if INSERT_POLICY != INSERT_LIFO
+            /*check 5.7 : if ordered lists are in order*/
+            if (index >= INSERT_FROM && index < MAXFREESIZE + !LARGE_TREE &&
+                NEXT_FREE(fp) != NULL && !free_before(fp, NEXT_FREE(fp)))
+                printf("Error: free list %d is out of order at %p\n",
+                       index, fp);
+            #endif
 
 
          }
+         #if INSERT_POLICY != INSERT_LIFO
+         /*check 5.8 : if every skip list level holds the right nodes*/
+         if (index >= INSERT_FROM && index >= SKIPLIST_FROM &&
+             index < MAXFREESIZE + !LARGE_TREE)
+         {
+             int l;
+             void *lp;
+             for (l = 1; l < SKIP_LEVELS; l++)
+             {
+                 lp = skip_next(ar, index, NULL, l);
+                 for (fp = ar->freelist[index-1]; fp != NULL;
+                      fp = NEXT_FREE(fp))
+                 {
+                     if (GET(SKIP_LEVELP(fp)) > (unsigned int)l)
+                     {
+                         if (lp != fp)
+                             printf("Error: skip list %d level %d misses %p\n",
+                                    index, l, fp);
+                         else
+                             lp = skip_next(ar, index, lp, l);
+                     }
+                 }
+                 if (lp != NULL)
+                     printf("Error: skip list %d level %d is too long\n",
+                            index, l);
+             }
+         }
+         #endif
+    }
+
+    #if LARGE_TREE
+    /*check 5.9: if the tree is a red-black tree of the last list*/
+    for (fp = ar->freelist[MAXFREESIZE-1], index = 0; fp != NULL;
+         fp = NEXT_FREE(fp), index++)
+    {
+        if (NEXT_FREE(fp) != NULL && !tree_before(fp, NEXT_FREE(fp)))
+            printf("Error: the last free list is out of order at %p\n",fp);
     }
+    if (checktree(ar->tree, NULL) < 0 || treesize(ar->tree) != index)
+        printf("Error: bad tree of arena %u\n", ar->index);
+    #endif
 
     /*check 5.5: if freelist is correctly counted by both way*/
     if (fblocknumbyfreelist!=fblocknumbynormal)
@@ -695,8 +3982,173 @@ int mm_checkheap(int verbose) {
         printf("free list pointer gives: %d free blocks\n",
                 fblocknumbyfreelist);
     }
+
     return 0;
 
 }
 
+#if LARGE_TREE
+/*
+ * checktree - check the subtree at x under parent, return its black
+ *             height or -1 if it is broken
+ */
+static int checktree(void *x, void *parent)
+{
+    int left, right;
+
+    if (x == NULL)
+        return 0;
+    if (TREE_PARENT(x) != parent || (tree_red(x) && tree_red(parent)) ||
+        (TREE_LEFT(x) != NULL && !tree_before(TREE_LEFT(x), x)) ||
+        (TREE_RIGHT(x) != NULL && !tree_before(x, TREE_RIGHT(x))))
+    {
+        printf("Error: bad tree node %p\n", x);
+        return -1;
+    }
+    left = checktree(TREE_LEFT(x), x);
+    right = checktree(TREE_RIGHT(x), x);
+    if (left < 0 || left != right)
+        return -1;
+    return left + !tree_red(x);
+}
+
+/*
+ * treesize - nodes in the subtree at x
+ */
+static int treesize(void *x)
+{
+    return x == NULL ? 0 : 1 + treesize(TREE_LEFT(x)) + treesize(TREE_RIGHT(x));
+}
+#endif
+
+#if TCACHE
+/*
+ * checktcache - check the calling thread's cache
+ */
+static void checktcache(void) {
+    void *fp;
+    int index;
+    /*check6: the calling thread's cache only holds allocated blocks,
+      none smaller than its bin (a refill may hand out an unsplit block)*/
+    if (tcache != NULL && tcache->gen == heap_gen)
+    {
+        for (index = 0; index < (int)TCACHE_BINS; index++)
+        {
+            unsigned int cached = 0;
+            for (fp = tcache->bin[index]; fp != NULL; fp = GETLP(fp))
+            {
+                cached++;
+                if (!in_heap(fp) || (!is_slab(fp) && !GET_ALLOC(HDRP(fp))) ||
+                    TCACHE_BIN(block_size(fp)) < (size_t)index)
+                    printf("Error: bad block %p in thread cache\n",fp);
+            }
+            if (cached != tcache->count[index])
+                printf("Error: thread cache bin %d miscounted\n",index);
+        }
+    }
+}
+#endif /* TCACHE */
+
+#ifdef Debug
+/*
+ * checkop - check arena ar after an operation left block bp, ar->lock
+ *           held: the whole heap every CHECK_EVERY operations, else only
+ *           what the operation touched
+ */
+static void checkop(struct arena *ar, void *bp) {
+    if (++ar->nchecks % CHECK_EVERY == 0)
+        checkheap(ar, Verbose);
+    else
+        checklocal(ar, bp);
+    ar->touched = 0;
+}
+
+/*
+ * checklocal - check block bp, its neighbours and the heads of the free
+ *              lists changed since the last check, in constant time
+ */
+static void checklocal(struct arena *ar, void *bp) {
+    void *blk[3];
+    void *fp;
+    int i, n = 0, index;
+
+    /*check8: bp and the neighbours it can reach are well formed*/
+    if (!ELIDE_FOOTERS || !PREV_ALLOCATED(bp))
+        blk[n++] = PREV_BLKP(bp);
+    blk[n++] = bp;
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) > 0)
+        blk[n++] = NEXT_BLKP(bp);
+    else if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))))
+        printf("Bad epilogue header\n");
+    for (i = 0; i < n; i++)
+    {
+        if (GET(HDRP(blk[i])) == PROLOGUE)
+            continue;
+        checkblock(blk[i]);
+        if (arena_of(blk[i]) != ar)
+            printf("Error: block %p is mapped to another arena\n",blk[i]);
+        if (GET_ALLOC(HDRP(blk[i])))
+            continue;
+        /*check 8.1: no two free blocks in a row*/
+        if (i + 1 < n && !GET_ALLOC(HDRP(blk[i + 1])))
+            printf("consecutive free block! @,(%p)",blk[i]);
+        checkFreeBlock(blk[i]);
+    }
+
+    /*check 8.2: the touched lists agree with their bitmap bit, head and
+      head size*/
+    for (index = 1; index <= MAXFREESIZE; index++)
+    {
+        if (!(ar->touched & LISTBIT(index)))
+            continue;
+        fp = ar->freelist[index-1];
+        if ((fp != NULL) != ((ar->freelistbitmap & LISTBIT(index)) != 0))
+            printf("Error: bitmap of free list %d is out of date\n",index);
+        if (ar->headsize[index-1] != (fp ? GET_SIZE(HDRP(fp)) : 0))
+            printf("Error: cached head size of free list %d is out of "
+                   "date\n",index);
+        if (fp == NULL)
+            continue;
+        if (!in_heap(fp) || GET_ALLOC(HDRP(fp)) || PREV_FREE(fp) != NULL ||
+            choosefreetable(fp) != index || arena_of(fp) != ar ||
+            (NEXT_FREE(fp) != NULL && PREV_FREE(NEXT_FREE(fp)) != fp))
+            printf("Error: bad head %p of free list %d\n",fp,index);
+    }
+}
+
+/*
+ * checksize - check that block bp holds asize bytes, as its sized free
+ *             claims
+ */
+static void checksize(void *bp, size_t asize) {
+    size_t size = block_size(bp);
+    /* A mapped block holds its whole pages, whatever the alignment */
+    if (is_mmapped(bp))
+        size = ALIGN(size);
+    /*check7: the block is not smaller, nor (unless it is mapped) larger
+      than the slack a split or an in-place realloc leaves*/
+    if (size < asize || (!is_mmapped(bp) && !is_slab(bp) &&
+                         size >= asize + MAX(MINBLOCK, REALLOC_SHRINK)))
+        printf("Error: block %p of %zu bytes freed as %zu bytes\n",
+               bp, size, asize);
+}
+
+#if MMAP_LARGE
+/*
+ * checkmapped - check the header of the mapped block bp
+ */
+static void checkmapped(void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t offset = MMAP_OFFSET(bp);
+    /*check9: the size leaves the tag bits alone and, with the offset of
+      the payload, spans whole pages*/
+    if ((GET(HDRP(bp)) & 0x7) != (1|MMAPPED) ||
+        offset < MMAP_OVERHEAD || offset > PAGESIZE ||
+        offset % ALIGNMENT != 0 || (size + offset) % PAGESIZE != 0)
+        printf("Error: bad header %#x of mapped block %p\n",
+               GET(HDRP(bp)), bp);
+}
+#endif /* MMAP_LARGE */
+#endif
+
 
@@ -0,0 +1,178 @@
+/*
+ * mm_new.cc
+ * _______________________________________________________________
+ * Replace the global operator new and delete of a C++ program with the
+ * allocator of mm_grade_91.c:
+ * 1. new allocates with malloc, whose blocks are aligned to MM_ALIGNMENT,
+ *    16, as __STDCPP_DEFAULT_NEW_ALIGNMENT__ asks (mm_memalign should a
+ *    target want more), and delete is free; a new that finds no memory
+ *    calls the new handler and tries again, as the standard asks.
+ * 2. Sized deletes go to mm_free_sized, which skips the header lookup
+ *    for the sizes of the thread cache.
+ * 3. The std::align_val_t overloads allocate with mm_memalign.  Aligned
+ *    blocks are ordinary blocks, so every delete frees them.
+ *
+ * Build:  g++ -std=c++17 -O2 -c mm_new.cc
+ *         and link mm_new.o with mm_grade_91.o.
+ */
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "mm_ext.h"
+
+#ifdef DRIVER
+/* The mm_ aliases of the driver tests */
+extern "C" {
+void *mm_malloc(std::size_t size);
+void mm_free(void *ptr);
+}
+#define malloc mm_malloc
+#define free mm_free
+#endif /* def DRIVER */
+
+/* Alignment of the plain new, what every C++ file expects of it */
+#define NEW_ALIGNMENT __STDCPP_DEFAULT_NEW_ALIGNMENT__
+
+/*
+ * new_block - size bytes aligned to alignment, calling the new handler
+ *             until it gives up with std::bad_alloc
+ */
+static void *new_block(std::size_t size, std::size_t alignment)
+{
+    void *p;
+
+    if (size == 0)
+        size = 1;
+    while ((p = alignment <= MM_ALIGNMENT ? malloc(size) :
+                mm_memalign(alignment, size)) == nullptr)
+    {
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+    return p;
+}
+
+/*
+ * new_block_nothrow - new_block, or nullptr instead of std::bad_alloc
+ */
+static void *new_block_nothrow(std::size_t size,
+                               std::size_t alignment) noexcept
+{
+    try
+    {
+        return new_block(size, alignment);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    return new_block(size, NEW_ALIGNMENT);
+}
+
+void *operator new[](std::size_t size)
+{
+    return new_block(size, NEW_ALIGNMENT);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return new_block_nothrow(size, NEW_ALIGNMENT);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return new_block_nothrow(size, NEW_ALIGNMENT);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return new_block(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return new_block(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept
+{
+    return new_block_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept
+{
+    return new_block_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+/* A size of 0 was allocated as 1 byte, which adjusts to the same block */
+void operator delete(void *ptr, std::size_t size) noexcept
+{
+    mm_free_sized(ptr, size);
+}
+
+void operator delete[](void *ptr, std::size_t size) noexcept
+{
+    mm_free_sized(ptr, size);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size, std::align_val_t) noexcept
+{
+    mm_free_sized(ptr, size);
+}
+
+void operator delete[](void *ptr, std::size_t size,
+                       std::align_val_t) noexcept
+{
+    mm_free_sized(ptr, size);
+}